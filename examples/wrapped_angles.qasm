@@ -0,0 +1,7 @@
+qreg q[4];
+rz(7.0) q[0];
+rz(-13.2) q[1];
+rzz(-6.571740) q[0],q[1];
+cp(20.5) q[2],q[3];
+rx(-6.749897) q[2];
+rxx(31.4) q[2],q[3];
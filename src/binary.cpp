@@ -0,0 +1,995 @@
+#include "headers.h"
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+	Binary formats (all integers are little-endian):
+
+	Header (16 bytes):
+		"JRGS" | u8 kind | u8 version (= 1) | u16 reserved | u32 number of data qubits | u32 number of records
+
+	Kind 1, rotation layer (BINARYKIND::ROTATIONS):
+		fixed 24-byte records after the header, so that a mapped file can be accessed directly,
+		u8 gate type (GATETYPE) | u8 number of qubits | u16 reserved | u32 qubit 0 | u32 qubit 1 | u32 reserved | u64 angle word,
+		where the qubits index the register "q", and the angle word is the angle in units of 2 * pi / 2^64.
+
+	Kind 3, angle matrix (BINARYKIND::ANGLES):
+		the header stores the number of columns (angles per point) in place of the number of data qubits and the number of points,
+		followed by the u64 angle words of the points in row-major order.
+
+	Kind 2, circuit (BINARYKIND::CIRCUIT):
+		a stream of records after the header until the end of the file (the numbers in the header are 0),
+		u8 opcode (BINARYOP) | operands,
+		where wires are LEB128 varints (the registers are numbered in their declaration order),
+		angles are IEEE 754 doubles, and strings are prefixed by their varint lengths.
+
+	Kind 4, synthesis plan (BINARYKIND::PLAN):
+		the header stores the number of segments as the number of records, followed by varints, doubles, and strings as in kind 2:
+		precision | cost_single | u8 is_same | #headers | headers |
+		#gates | gates as (u8 gate type | #qubits | qubits | u8 is_exact | numerator | log_denominator | radians | tolerated error) |
+		segments as (block id + 1 | pass-through line if the block id is -1, otherwise #gates | gate ids) |
+		#blocks | the plan of each block as a string (empty if not synthesized),
+		where the plan of a block is written by 'Optimizer::writePlan':
+		u8 flags (1: concrete, 2: optimized, 4: Hamming-weight phasing or carry-save compressor) | precision | last angle | cost | lower bound | size of the cost model |
+		#gates | gates as (u8 gate type | #qubits | qubits | precision) |
+		bit table as (#bits | bits) for each column, where a bit is (u8 bit type | gate id) or (u8 BITTYPE::CAR | power | #carry-ins | carry-in bits) |
+		heights, carries, counter bits, split-from bits, split-to bits, and (#counters | counter sizes) for each column |
+		#excluded gates | excluded gates as (gate id | angle) in the order of the ids |
+		#table lookups | table lookups as (#gates | gate ids | the signed digit of each gate for each column).
+		Signed integers are written as varints of their 64-bit two's complements.
+*/
+
+const char BINARY_MAGIC[4] = { 'J', 'R', 'G', 'S' };
+const int BINARY_VERSION = 1;
+const int BINARY_HEADER_SIZE = 16;
+const int BINARY_ROTATION_SIZE = 24;
+
+// gates with a fixed number of wires and no parameter
+const vector<pair<string, int>> BINARY_FIXED_GATES = {
+	{"x", 1}, {"y", 1}, {"z", 1}, {"h", 1}, {"s", 1}, {"sdg", 1}, {"t", 1}, {"tdg", 1},
+	{"cx", 2}, {"cz", 2}, {"swap", 2}, {"ccx", 3}
+};
+const vector<string> BINARY_ANGLE_GATES = { "rx", "ry", "rz", "p" };	// gates with an angle and a wire
+
+/* ===== Function Description:
+	Little-endian encoding helpers.
+*/
+void putUint(string& buffer, unsigned long long value, int n_bytes) {
+	for (int i = 0; i < n_bytes; ++i) {
+		buffer += (char)((value >> (8 * i)) & 0xFF);
+	}
+}
+
+unsigned long long getUint(const unsigned char* data, int n_bytes) {
+	unsigned long long value = 0;
+	for (int i = 0; i < n_bytes; ++i) {
+		value |= (unsigned long long)data[i] << (8 * i);
+	}
+	return value;
+}
+
+void putVarint(string& buffer, unsigned long long value) {
+	while (value >= 0x80) {
+		buffer += (char)((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	buffer += (char)value;
+}
+
+/* ===== Function Description:
+	Read a varint at 'pos' and advance it.
+	Return false if the data end before the varint does.
+*/
+bool getVarint(const unsigned char* data, size_t size, size_t& pos, unsigned long long& value) {
+	value = 0;
+	for (int shift = 0; pos < size && shift < 64; shift += 7) {
+		unsigned char byte = data[pos++];
+		value |= (unsigned long long)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0) return true;
+	}
+	return false;
+}
+
+void putDouble(string& buffer, double value) {
+	unsigned long long bits;
+	memcpy(&bits, &value, sizeof(bits));
+	putUint(buffer, bits, 8);
+}
+
+void putString(string& buffer, const string& text) {
+	putVarint(buffer, text.size());
+	buffer += text;
+}
+
+class PlanReader {		// a cursor over the varints, doubles, and strings of a plan, which becomes invalid if the data end early
+public:
+	PlanReader(const unsigned char* data, size_t size) : _data(data), _size(size) {}
+	bool isValid() { return _is_valid; }
+	bool isEnd() { return _is_valid && _pos == _size; }
+	void invalidate() { _is_valid = false; }
+	unsigned long long varint() {
+		unsigned long long value = 0;
+		if (_is_valid) _is_valid = getVarint(_data, _size, _pos, value);
+		return value;
+	}
+	long long signedVarint() { return (long long)varint(); }
+	int number(long long limit) {		// a varint in [0, limit]
+		unsigned long long value = varint();
+		if (limit < 0 || value > (unsigned long long)limit) _is_valid = false;
+		return _is_valid ? value : 0;
+	}
+	int count() { return number(min(_size - _pos, (size_t)INT_MAX)); }	// a number of items, each of which takes at least a byte
+	int byte() {
+		if (_pos >= _size) _is_valid = false;
+		return _is_valid ? _data[_pos++] : 0;
+	}
+	double real() {
+		if (_size - _pos < 8) _is_valid = false;
+		if (!_is_valid) return 0;
+		unsigned long long bits = getUint(_data + _pos, 8);
+		double value;
+		memcpy(&value, &bits, sizeof(value));
+		_pos += 8;
+		return value;
+	}
+	string text() {
+		int length = count();
+		if (!_is_valid) return "";
+		string value((const char*)_data + _pos, length);
+		_pos += length;
+		return value;
+	}
+private:
+	const unsigned char* _data;
+	size_t _size;
+	size_t _pos = 0;
+	bool _is_valid = true;
+};
+
+string binaryHeader(BINARYKIND kind, unsigned int n_qubits, unsigned int n_records) {
+	string header(BINARY_MAGIC, 4);
+	putUint(header, kind, 1);
+	putUint(header, BINARY_VERSION, 1);
+	putUint(header, 0, 2);
+	putUint(header, n_qubits, 4);
+	putUint(header, n_records, 4);
+	return header;
+}
+
+/* ===== Function Description:
+	Convert an angle into a fixed-point word in units of 2 * pi / 2^64.
+	Exact angles are converted without rounding if their denominators are at most 2^64.
+*/
+unsigned long long angleToWord(const Angle& angle) {
+	if (angle.is_exact) {
+		if (angle.log_denominator == 0) return 0;
+		return (unsigned long long)angle.numerator << (64 - angle.log_denominator);
+	}
+	long double fraction = fmodl((long double)angle.radians / (2 * M_PIl), 1);
+	if (fraction < 0) fraction += 1;
+	long double word = floorl(ldexpl(fraction, 64) + 0.5L);
+	return (word >= ldexpl(1, 64)) ? 0 : (unsigned long long)word;
+}
+
+/* ===== Function Description:
+	Convert a fixed-point word in units of 2 * pi / 2^64 into an exact angle.
+	Words finer than the exact-angle limit of 2^62 are rounded.
+*/
+Angle wordToAngle(unsigned long long word) {
+	int log_denominator = 62;
+	word = ((word >> 2) + ((word >> 1) & 1)) & ((1ULL << 62) - 1);		// round half up to 62 bits (modulo a full turn)
+
+	Angle angle;
+	angle.is_exact = true;
+	if (word == 0) return angle;
+	while ((word & 1) == 0) {
+		word >>= 1;
+		log_denominator--;
+	}
+	angle.numerator = (long long)word;
+	angle.log_denominator = log_denominator;
+	angle.radians = ldexp((double)word, -log_denominator) * 2 * M_PI;
+	return angle;
+}
+
+/* ===== Function Description:
+	Format an angle as an openQASM expression, e.g., "3*pi/8" for exact angles.
+*/
+string angleToQasm(const Angle& angle) {
+	stringstream ss;
+	if (angle.is_exact) {
+		if (angle.numerator == 0) return "0";
+		ss << angle.numerator << "*pi";
+		if (angle.log_denominator > 1) ss << "/" << (1ULL << (angle.log_denominator - 1));
+		return ss.str();
+	}
+	ss << setprecision(numeric_limits<double>::max_digits10) << angle.radians;
+	return ss.str();
+}
+
+// ==================================================
+
+/* ===== Function Description:
+	Map a file into memory (or read it on systems without 'mmap').
+*/
+BinaryFile::BinaryFile(const string& file_name) {
+#ifdef __unix__
+	int fd = open(file_name.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+		void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped != MAP_FAILED) {
+			_data = (const unsigned char*)mapped;
+			_size = st.st_size;
+			_is_mapped = true;
+		}
+	}
+	if (fd >= 0) close(fd);
+	if (_is_mapped) return;
+#endif
+	ifstream in_file(file_name, ios::in | ios::binary);
+	_buffer.assign(istreambuf_iterator<char>(in_file), istreambuf_iterator<char>());
+	_data = (const unsigned char*)_buffer.data();
+	_size = _buffer.size();
+}
+
+BinaryFile::~BinaryFile() {
+#ifdef __unix__
+	if (_is_mapped) munmap((void*)_data, _size);
+#endif
+}
+
+/* ===== Function Description:
+	Check the header. Return the kind of the file, or 0 if it is not a binary circuit file.
+*/
+int BinaryFile::getKind() const {
+	if (_size < BINARY_HEADER_SIZE || memcmp(_data, BINARY_MAGIC, 4) != 0) return 0;
+	if (_data[5] != BINARY_VERSION) return 0;
+	return _data[4];
+}
+
+unsigned int BinaryFile::getNumQubits() const {
+	return getUint(_data + 8, 4);
+}
+
+unsigned int BinaryFile::getNumRecords() const {
+	return getUint(_data + 12, 4);
+}
+
+/* ===== Function Description:
+	Check whether a file starts with the header of the binary formats.
+*/
+bool isBinaryFile(const string& file_name) {
+	ifstream in_file(file_name, ios::in | ios::binary);
+	char magic[4];
+	return in_file.read(magic, 4) && memcmp(magic, BINARY_MAGIC, 4) == 0;
+}
+
+// ==================================================
+
+/* ===== Function Description:
+	Write a rotation layer on 'n_qubits' data qubits in the binary format (kind 1).
+*/
+void writeBinaryRotations(ostream& ofs, int n_qubits, const vector<GateSpec>& gates) {
+	string buffer = binaryHeader(BINARYKIND::ROTATIONS, n_qubits, gates.size());
+	for (const GateSpec& gate : gates) {
+		putUint(buffer, gate.type, 1);
+		putUint(buffer, gate.qubits.size(), 1);
+		putUint(buffer, 0, 2);
+		putUint(buffer, gate.qubits.size() > 0 ? gate.qubits[0] : UINT_MAX, 4);
+		putUint(buffer, gate.qubits.size() > 1 ? gate.qubits[1] : UINT_MAX, 4);
+		putUint(buffer, 0, 4);
+		putUint(buffer, angleToWord(gate.angle), 8);
+	}
+	ofs.write(buffer.data(), buffer.size());
+}
+
+/* ===== Function Description:
+	Read a rotation layer in the binary format (kind 1).
+	Return the number of data qubits, or -1 if the file is not a valid rotation layer.
+*/
+int readBinaryRotations(const BinaryFile& file, vector<GateSpec>& gates) {
+	if (file.getKind() != BINARYKIND::ROTATIONS) return -1;
+	unsigned int n_records = file.getNumRecords();
+	if (file.getSize() < BINARY_HEADER_SIZE + (size_t)n_records * BINARY_ROTATION_SIZE) return -1;
+
+	gates.clear();
+	gates.reserve(n_records);
+	for (unsigned int i = 0; i < n_records; ++i) {
+		const unsigned char* record = file.getData() + BINARY_HEADER_SIZE + (size_t)i * BINARY_ROTATION_SIZE;
+		GateSpec gate;
+		if (record[0] > GATETYPE::CP) return -1;
+		gate.type = (GATETYPE)record[0];
+		int n_qubits = (gate.type == GATETYPE::RXX || gate.type == GATETYPE::RYY || gate.type == GATETYPE::RZZ || gate.type == GATETYPE::CP) ? 2 : 1;
+		if (record[1] != n_qubits) return -1;
+		for (int k = 0; k < n_qubits; ++k) {
+			unsigned int qubit = getUint(record + 4 + 4 * k, 4);
+			if (qubit >= file.getNumQubits()) return -1;
+			gate.qubits.emplace_back(qubit);
+		}
+		gate.angle = wordToAngle(getUint(record + 16, 8));
+		gates.emplace_back(gate);
+	}
+	return file.getNumQubits();
+}
+
+/* ===== Function Description:
+	Write a matrix of angle vectors (all of the same length) in the binary format (kind 3).
+*/
+void writeBinaryAngleMatrix(ostream& ofs, const vector<vector<Angle>>& points) {
+	string buffer = binaryHeader(BINARYKIND::ANGLES, points.empty() ? 0 : points[0].size(), points.size());
+	for (const vector<Angle>& point : points) {
+		for (const Angle& angle : point) {
+			putUint(buffer, angleToWord(angle), 8);
+		}
+	}
+	ofs.write(buffer.data(), buffer.size());
+}
+
+/* ===== Function Description:
+	Read a matrix of angle vectors in the binary format (kind 3).
+	Return false if the file is not a valid angle matrix.
+*/
+bool readBinaryAngleMatrix(const BinaryFile& file, vector<vector<Angle>>& points) {
+	if (file.getKind() != BINARYKIND::ANGLES) return false;
+	size_t n_columns = file.getNumQubits();
+	size_t n_points = file.getNumRecords();
+	if ((file.getSize() - BINARY_HEADER_SIZE) / 8 < n_columns * n_points) return false;
+
+	points.assign(n_points, vector<Angle>(n_columns));
+	const unsigned char* word = file.getData() + BINARY_HEADER_SIZE;
+	for (vector<Angle>& point : points) {
+		for (Angle& angle : point) {
+			angle = wordToAngle(getUint(word, 8));
+			word += 8;
+		}
+	}
+	return true;
+}
+
+// ==================================================
+
+/* ===== Function Description:
+	Constructor of the 'BinaryCircuitWriter' class, which writes the header of a streamed circuit (kind 2).
+*/
+BinaryCircuitWriter::BinaryCircuitWriter(ostream& ofs) : _ofs(ofs) {
+	string header = binaryHeader(BINARYKIND::CIRCUIT, 0, 0);
+	_ofs.write(header.data(), header.size());
+}
+
+/* ===== Function Description:
+	Write the lines of a piece of openQASM text.
+	The binary format is encoded from the text, not from the gates of the exporters:
+	the exporters write openQASM to any 'ostream', and the text of a block is also the unit that is
+	cached for the repeated blocks, rewritten by 'RotationSynthesizer', and counted by 'CliffordTCounter',
+	so encoding it once here keeps a single writer per gate, and the two formats cannot disagree.
+*/
+void BinaryCircuitWriter::writeText(const string& text) {
+	size_t begin = 0;
+	while (begin < text.size()) {
+		size_t end = text.find('\n', begin);
+		if (end == string::npos) end = text.size();
+		writeLine(text.substr(begin, end - begin));
+		begin = end + 1;
+	}
+}
+
+/* ===== Function Description:
+	Write an openQASM line as a record.
+	Register declarations and the gates in the opcode table on single wires (e.g., "anc[3]") are encoded,
+	and the other lines are kept as text records.
+*/
+void BinaryCircuitWriter::writeLine(const string& line) {
+	string buffer;
+	if (encodeLine(line, buffer)) {
+		_ofs.write(buffer.data(), buffer.size());
+		return;
+	}
+	buffer.clear();
+	putUint(buffer, BINARYOP::OP_TEXT, 1);
+	putVarint(buffer, line.size());
+	buffer += line;
+	_ofs.write(buffer.data(), buffer.size());
+}
+
+/* ===== Function Description:
+	Encode a register declaration or a gate in the opcode table.
+	Return false if the line has to be kept as text.
+*/
+bool BinaryCircuitWriter::encodeLine(const string& line, string& buffer) {
+	size_t begin = line.find_first_not_of(" \t\r");
+	size_t end = line.find_last_not_of(" \t\r");
+	if (begin == string::npos || line[end] != ';') return false;
+	string statement = line.substr(begin, end - begin);		// without ';'
+	if (statement.find(';') != string::npos) return false;
+
+	size_t name_end = statement.find_first_of(" (\t");
+	if (name_end == string::npos) return false;
+	string name = statement.substr(0, name_end);
+
+	// parameter
+	size_t operand_begin = name_end;
+	double angle = 0;
+	if (statement[name_end] == '(') {
+		size_t close = statement.find(')', name_end);
+		if (close == string::npos) return false;
+		string parameter = statement.substr(name_end + 1, close - name_end - 1);
+		size_t n_parsed = 0;
+		try { angle = stod(parameter, &n_parsed); }
+		catch (...) { return false; }
+		if (parameter.find_first_not_of(" \t", n_parsed) != string::npos) return false;	// not a plain number
+		operand_begin = close + 1;
+	}
+
+	// operands
+	vector<unsigned long long> wires;
+	stringstream operands_ss(statement.substr(operand_begin));
+	string operand;
+	while (getline(operands_ss, operand, ',')) {
+		operand.erase(remove_if(operand.begin(), operand.end(), ::isspace), operand.end());
+		size_t bracket = operand.find('[');
+		if (bracket == string::npos || operand.back() != ']') return false;
+		string reg = operand.substr(0, bracket);
+		int index;
+		try { index = stoi(operand.substr(bracket + 1)); }
+		catch (...) { return false; }
+
+		if (name == "qreg") {
+			if (_registers.count(reg) > 0) return false;
+			putUint(buffer, BINARYOP::OP_QREG, 1);
+			putVarint(buffer, reg.size());
+			buffer += reg;
+			putVarint(buffer, index);
+			_registers[reg] = make_pair(_n_wires, index);
+			_n_wires += index;
+			return true;
+		}
+		if (_registers.count(reg) == 0 || index < 0 || index >= _registers[reg].second) return false;
+		wires.emplace_back(_registers[reg].first + index);
+	}
+	if (wires.empty()) return false;
+
+	// opcode
+	bool has_angle = (operand_begin != name_end);
+	for (int i = 0; i < BINARY_FIXED_GATES.size(); ++i) {
+		if (BINARY_FIXED_GATES[i].first == name && BINARY_FIXED_GATES[i].second == wires.size() && !has_angle) {
+			putUint(buffer, BINARYOP::OP_FIXED + i, 1);
+			for (unsigned long long wire : wires) putVarint(buffer, wire);
+			return true;
+		}
+	}
+	for (int i = 0; i < BINARY_ANGLE_GATES.size(); ++i) {
+		if (BINARY_ANGLE_GATES[i] == name && wires.size() == 1 && has_angle) {
+			putUint(buffer, BINARYOP::OP_ANGLE + i, 1);
+			unsigned long long bits;
+			memcpy(&bits, &angle, sizeof(bits));
+			putUint(buffer, bits, 8);
+			putVarint(buffer, wires[0]);
+			return true;
+		}
+	}
+	if (name == "mcx" && !has_angle) {
+		putUint(buffer, BINARYOP::OP_MCX, 1);
+		putVarint(buffer, wires.size());
+		for (unsigned long long wire : wires) putVarint(buffer, wire);
+		return true;
+	}
+	return false;
+}
+
+// ==================================================
+
+/* ===== Function Description:
+	Decode a binary file into openQASM lines, which are passed to 'handle_line'.
+	A rotation layer is decoded with the headers of its data register and exact angle expressions.
+	Return false with a message if the file is malformed.
+*/
+bool readBinaryCircuit(const BinaryFile& file, const function<void(const string&)>& handle_line, string& message) {
+	int kind = file.getKind();
+	if (kind == BINARYKIND::ROTATIONS) {
+		vector<GateSpec> gates;
+		int n_qubits = readBinaryRotations(file, gates);
+		if (n_qubits < 0) {
+			message = "malformed rotation records";
+			return false;
+		}
+		const string gate_names[] = { "rx", "ry", "rz", "rxx", "ryy", "rzz", "p", "cp" };
+		handle_line("OPENQASM 2.0;");
+		handle_line("include \"qelib1.inc\";");
+		handle_line("qreg q[" + to_string(n_qubits) + "];");
+		for (GateSpec& gate : gates) {
+			string line = gate_names[gate.type] + "(" + angleToQasm(gate.angle) + ")";
+			for (int k = 0; k < gate.qubits.size(); ++k) {
+				line += string(k == 0 ? " " : ", ") + "q[" + to_string(gate.qubits[k]) + "]";
+			}
+			handle_line(line + ";");
+		}
+		return true;
+	}
+	if (kind != BINARYKIND::CIRCUIT) {
+		message = "not a binary circuit file";
+		return false;
+	}
+
+	const unsigned char* data = file.getData();
+	size_t size = file.getSize();
+	size_t pos = BINARY_HEADER_SIZE;
+	vector<string> wire_names;
+	bool is_valid = true;
+	while (is_valid && pos < size) {
+		size_t record_begin = pos;
+		int opcode = data[pos++];
+		unsigned long long value;
+		string line;
+		if (opcode == BINARYOP::OP_TEXT || opcode == BINARYOP::OP_QREG) {
+			is_valid = getVarint(data, size, pos, value) && value <= size - pos;
+			if (!is_valid) continue;
+			string text((const char*)data + pos, value);
+			pos += value;
+			if (opcode == BINARYOP::OP_TEXT) {
+				line = text;
+			}
+			else {
+				is_valid = getVarint(data, size, pos, value);
+				for (unsigned long long i = 0; is_valid && i < value; ++i) {
+					wire_names.emplace_back(text + "[" + to_string(i) + "]");
+				}
+				line = "qreg " + text + "[" + to_string(value) + "];";
+			}
+		}
+		else {
+			int n_wires = 0;
+			if (opcode >= BINARYOP::OP_FIXED && opcode < BINARYOP::OP_FIXED + BINARY_FIXED_GATES.size()) {
+				line = BINARY_FIXED_GATES[opcode - BINARYOP::OP_FIXED].first;
+				n_wires = BINARY_FIXED_GATES[opcode - BINARYOP::OP_FIXED].second;
+			}
+			else if (opcode >= BINARYOP::OP_ANGLE && opcode < BINARYOP::OP_ANGLE + BINARY_ANGLE_GATES.size()) {
+				is_valid = (pos + 8 <= size);
+				if (!is_valid) continue;
+				unsigned long long bits = getUint(data + pos, 8);
+				double angle;
+				memcpy(&angle, &bits, sizeof(angle));
+				pos += 8;
+				stringstream ss;
+				ss << setprecision(numeric_limits<double>::max_digits10) << angle;
+				line = BINARY_ANGLE_GATES[opcode - BINARYOP::OP_ANGLE] + "(" + ss.str() + ")";
+				n_wires = 1;
+			}
+			else if (opcode == BINARYOP::OP_MCX) {
+				is_valid = getVarint(data, size, pos, value) && value <= size - pos;	// a varint has at least a byte
+				line = "mcx";
+				n_wires = value;
+			}
+			else {
+				is_valid = false;
+			}
+
+			for (int k = 0; is_valid && k < n_wires; ++k) {
+				is_valid = getVarint(data, size, pos, value) && value < wire_names.size();
+				if (is_valid) line += string(k == 0 ? " " : ", ") + wire_names[value];
+			}
+			line += ";";
+		}
+		if (!is_valid) {
+			message = "malformed record at byte " + to_string(record_begin);
+			return false;
+		}
+		handle_line(line);
+	}
+	return true;
+}
+
+// ==================================================
+
+/* ===== Function Description:
+	Convert a circuit between openQASM and the binary formats without synthesis.
+	A binary file is converted into openQASM, and an angle matrix is converted between CSV (by the ".csv" extension) and binary.
+	An openQASM file is converted into a rotation layer (kind 1) if it only contains rotation gates on the register "q",
+	and into a streamed circuit (kind 2) otherwise.
+	Return false with a message if the conversion fails.
+*/
+bool convertCircuit(const string& in_file_name, const string& out_file_name, string& message) {
+	bool is_csv = (in_file_name.size() >= 4 && in_file_name.substr(in_file_name.size() - 4) == ".csv");
+	if (is_csv || BinaryFile(in_file_name).getKind() == BINARYKIND::ANGLES) {
+		vector<vector<Angle>> points;
+		if (!readAngleMatrix(in_file_name, points, message)) return false;
+		for (vector<Angle>& point : points) {
+			if (point.size() != points[0].size()) {
+				message = "the rows have different numbers of angles";
+				return false;
+			}
+		}
+		if (is_csv) {
+			ofstream ofs(out_file_name, ios::out | ios::binary);
+			writeBinaryAngleMatrix(ofs, points);
+			return true;
+		}
+		ofstream ofs(out_file_name);
+		for (vector<Angle>& point : points) {
+			for (int i = 0; i < point.size(); ++i) {
+				ofs << (i == 0 ? "" : ",") << angleToQasm(point[i]);
+			}
+			ofs << "\n";
+		}
+		return true;
+	}	// angle matrix
+
+	if (isBinaryFile(in_file_name)) {
+		BinaryFile file(in_file_name);
+		ofstream ofs(out_file_name);
+		return readBinaryCircuit(file, [&](const string& line) { ofs << line << "\n"; }, message);
+	}
+
+	ifstream in_file(in_file_name, ios::in);
+	if (!in_file.good()) {
+		message = "file \"" + in_file_name + "\" is not found";
+		return false;
+	}
+	vector<string> lines;
+	string line;
+	while (getline(in_file, line)) {
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		lines.emplace_back(line);
+	}
+
+	// rotation layer
+	int n_qubits = -1;
+	vector<GateSpec> gates;
+	bool is_rotation_layer = true;
+	for (string& qasm_line : lines) {
+		string code = qasm_line.substr(0, qasm_line.find("//"));
+		if (code.find_first_not_of(" \t") == string::npos) continue;
+		string word = code.substr(0, code.find_first_of(" (\t"));
+		GateSpec gate;
+		if (word == "OPENQASM" || word == "include") continue;
+		if (word == "qreg" && n_qubits == -1 && code.find(" q[") != string::npos) {
+			n_qubits = stoi(code.substr(code.find('[') + 1));
+			continue;
+		}
+		if (n_qubits != -1 && code.find(" q[") != string::npos && parseRotation(code, gate.type, gate.angle, gate.qubits)) {
+			gates.emplace_back(gate);
+			continue;
+		}
+		is_rotation_layer = false;
+		break;
+	}
+
+	ofstream ofs(out_file_name, ios::out | ios::binary);
+	if (is_rotation_layer && n_qubits != -1) {
+		writeBinaryRotations(ofs, n_qubits, gates);
+		return true;
+	}
+	BinaryCircuitWriter writer(ofs);
+	for (string& qasm_line : lines) {
+		writer.writeLine(qasm_line);
+	}
+	return true;
+}
+
+// ==================================================
+
+/* ===== Function Description:
+	Encode the state of the optimizer as a plan (see the plan format above).
+	A concrete plan can be exported directly, an optimized one only needs 'concrete',
+	and any other one is a checkpoint of 'optimize', where the cost is the one paid so far.
+*/
+string Optimizer::writePlan() {
+	string plan;
+	putUint(plan, (_is_concrete ? 1 : 0) | (_is_optimized ? 2 : 0) | (_is_hamming ? 4 : 0), 1);
+	putVarint(plan, _r);
+	putDouble(plan, _last_angle);
+	putDouble(plan, _optimized_cost);
+	putDouble(plan, _lower_bound);
+	putVarint(plan, _max_counter_size);
+
+	putVarint(plan, _gate_list.size());
+	for (Gate* gate : _gate_list) {
+		putUint(plan, gate->getType(), 1);
+		putVarint(plan, gate->getNumQubits());
+		for (int k = 0; k < gate->getNumQubits(); ++k) {
+			putVarint(plan, gate->getQubit(k));
+		}
+		putVarint(plan, gate->getPrecision());
+	}
+
+	function<void(const Bit&)> put_bit = [&](const Bit& bit) {
+		putUint(plan, bit.getType(), 1);
+		if (bit.getType() != BITTYPE::CAR) {
+			putVarint(plan, bit.getGateId());
+			return;
+		}
+		putVarint(plan, bit.getPower());
+		putVarint(plan, bit.getCarryIns().size());
+		for (const Bit& carry_in : bit.getCarryIns()) {
+			put_bit(carry_in);
+		}
+	};
+	for (int i = 0; i < _r; ++i) {
+		putVarint(plan, _bit_table[i].size());
+		for (const Bit& bit : _bit_table[i]) {
+			put_bit(bit);
+		}
+	}
+
+	for (int i = 0; i < _r; ++i) {
+		for (int value : { _heights[i], _n_carry[i], _n_counter[i], _n_split_from[i], _n_split_to[i] }) {
+			putVarint(plan, (long long)value);
+		}
+		putVarint(plan, _counter_sizes[i].size());
+		for (int counter_size : _counter_sizes[i]) {
+			putVarint(plan, counter_size);
+		}
+	}
+
+	putVarint(plan, _excluded.size());
+	for (auto& item : _excluded) {
+		putVarint(plan, item.first);
+		putDouble(plan, item.second);
+	}
+
+	putVarint(plan, _lookups.size());
+	for (Lookup& lookup : _lookups) {
+		putVarint(plan, lookup.gate_ids.size());
+		for (int gate_id : lookup.gate_ids) {
+			putVarint(plan, gate_id);
+		}
+		for (vector<int>& digits : lookup.digits) {
+			for (int digit : digits) {
+				putVarint(plan, (long long)digit);
+			}
+		}
+	}
+	return plan;
+}
+
+/* ===== Function Description:
+	Load a plan written by 'writePlan' into a new optimizer (without gates) of the same precision, mode, and single-gate cost.
+	The adder type and the Toffoli costs may differ, since a concrete plan does not depend on them.
+	Return false if the plan is malformed or does not match the settings.
+*/
+bool Optimizer::readPlan(const string& plan) {
+	PlanReader reader((const unsigned char*)plan.data(), plan.size());
+	int flags = reader.byte();
+	int r = reader.number(_config.getPrecision());
+	if (!reader.isValid() || r < 1 || (r != _config.getPrecision() && !_config.isSame())) return false;
+	_r = r;
+	_last_angle = reader.real();
+	_optimized_cost = reader.real();
+	_lower_bound = reader.real();
+	_max_counter_size = reader.number(INT_MAX);
+
+	int n_gates = reader.count();
+	set<int>* axis_sets[3] = { &_involved_qubits_x, &_involved_qubits_y, &_involved_qubits_z };
+	for (int id = 0; id < n_gates && reader.isValid(); ++id) {
+		int gate_type = reader.byte();
+		int n_qubits = reader.number(2);
+		if (gate_type > GATETYPE::CP || n_qubits != ((gate_type == GATETYPE::RXX || gate_type == GATETYPE::RYY || gate_type == GATETYPE::RZZ || gate_type == GATETYPE::CP) ? 2 : 1)) return false;
+		vector<int> qubits;
+		for (int k = 0; k < n_qubits; ++k) {
+			qubits.emplace_back(reader.number(INT_MAX));
+		}
+		int precision = reader.number(INT_MAX);
+		int axis = getAxis((GATETYPE)gate_type);
+		for (int qubit : qubits) {
+			if (axis_sets[(axis + 1) % 3]->count(qubit) > 0 || axis_sets[(axis + 2) % 3]->count(qubit) > 0) return false;
+			axis_sets[axis]->insert(qubit);
+		}
+		_gate_list.emplace_back(new Gate(id, (GATETYPE)gate_type, qubits, precision));
+	}
+	_n = _gate_list.size();
+
+	function<Bit(bool)> get_bit = [&](bool is_carry_in) {
+		int bit_type = reader.byte();
+		if (bit_type == BITTYPE::CAR && !is_carry_in) {		// the carry-ins of a counter are gate bits
+			int power = reader.number(_r);
+			vector<Bit> carry_ins;
+			int n_carry_ins = reader.count();
+			for (int k = 0; k < n_carry_ins && reader.isValid(); ++k) {
+				carry_ins.emplace_back(get_bit(true));
+			}
+			return Bit(carry_ins, power);
+		}
+		int gate_id = reader.number(_n - 1);
+		if (bit_type > BITTYPE::NEG) reader.invalidate();
+		return Bit(reader.isValid() ? (BITTYPE)bit_type : BITTYPE::POS, reader.isValid() ? _gate_list[gate_id] : nullptr);
+	};
+	_bit_table.assign(_r, vector<Bit>());
+	for (int i = 0; i < _r && reader.isValid(); ++i) {
+		int n_bits = reader.count();
+		for (int k = 0; k < n_bits && reader.isValid(); ++k) {
+			_bit_table[i].emplace_back(get_bit(false));
+		}
+	}
+	if (!reader.isValid()) return false;
+
+	_heights.assign(_r, 0);
+	_n_carry.assign(_r, 0);
+	_n_counter.assign(_r, 0);
+	_n_split_from.assign(_r, 0);
+	_n_split_to.assign(_r, 0);
+	_counter_sizes.assign(_r, vector<int>());
+	for (int i = 0; i < _r; ++i) {
+		for (int* value : { &_heights[i], &_n_carry[i], &_n_counter[i], &_n_split_from[i], &_n_split_to[i] }) {
+			*value = reader.signedVarint();
+		}
+		int n_counters = reader.count();
+		for (int k = 0; k < n_counters; ++k) {
+			_counter_sizes[i].emplace_back(reader.number(INT_MAX));
+		}
+	}
+
+	int n_excluded = reader.count();
+	for (int k = 0; k < n_excluded; ++k) {
+		int gate_id = reader.number(_n - 1);
+		_excluded[gate_id] = reader.real();
+	}
+
+	int n_lookups = reader.isEnd() ? 0 : reader.count();		// plans without table lookups end here
+	for (int k = 0; k < n_lookups && reader.isValid(); ++k) {
+		Lookup lookup;
+		int width = reader.number(16);
+		for (int j = 0; j < width; ++j) {
+			lookup.gate_ids.emplace_back(reader.number(_n - 1));
+		}
+		lookup.digits.assign(width, vector<int>(_r, 0));
+		for (vector<int>& digits : lookup.digits) {
+			for (int& digit : digits) {
+				digit = reader.signedVarint();
+				if (digit < -1 || digit > 1) reader.invalidate();
+			}
+		}
+		set<int> gate_ids(lookup.gate_ids.begin(), lookup.gate_ids.end());
+		if (width == 0 || gate_ids.size() != width) return false;
+		_lookups.emplace_back(lookup);
+	}
+	if (!reader.isEnd()) return false;
+
+	_is_concrete = (flags & 1) != 0;
+	_is_optimized = (flags & 2) != 0;
+	_is_hamming = (flags & 4) != 0;
+	_is_resumed = !_is_optimized;
+	if (_is_concrete) allocateAncilla();
+	return true;
+}
+
+/* ===== Function Description:
+	Write the plan of the circuit: the parsed circuit and the plans of the synthesized blocks.
+	The file is replaced at once, so that an interrupted checkpoint keeps the previous plan.
+*/
+void Frontend::writePlan(const string& file_name) {
+	string buffer = binaryHeader(BINARYKIND::PLAN, 0, _segments.size());
+	putVarint(buffer, _config.getPrecision());
+	putDouble(buffer, _config.getCostSingle());
+	putUint(buffer, _config.isSame(), 1);
+	putVarint(buffer, _headers.size());
+	for (string& header : _headers) {
+		putString(buffer, header);
+	}
+
+	putVarint(buffer, _gates.size());
+	for (GateSpec& gate : _gates) {
+		putUint(buffer, gate.type, 1);
+		putVarint(buffer, gate.qubits.size());
+		for (int qubit : gate.qubits) {
+			putVarint(buffer, qubit);
+		}
+		putUint(buffer, gate.angle.is_exact, 1);
+		putVarint(buffer, gate.angle.numerator);
+		putVarint(buffer, gate.angle.log_denominator);
+		putDouble(buffer, gate.angle.radians);
+		putDouble(buffer, gate.max_error);
+	}
+
+	for (Segment& segment : _segments) {
+		putVarint(buffer, segment.block_id + 1);
+		if (segment.block_id == -1) {
+			putString(buffer, segment.line);
+			continue;
+		}
+		putVarint(buffer, segment.gate_ids.size());
+		for (int id : segment.gate_ids) {
+			putVarint(buffer, id);
+		}
+	}
+
+	putVarint(buffer, _blocks.size());
+	for (int i = 0; i < _blocks.size(); ++i) {
+		putString(buffer, (i < _block_plans.size()) ? _block_plans[i] : "");
+	}
+
+	string temp_file_name = file_name + ".tmp";
+	ofstream ofs(temp_file_name, ios::out | ios::binary);
+	ofs.write(buffer.data(), buffer.size());
+	ofs.close();
+	if (!ofs.good() || rename(temp_file_name.c_str(), file_name.c_str()) != 0) {
+		cerr << "[Error]: Cannot write the plan \"" << file_name << "\"." << endl;
+		exit(-1);
+	}
+}
+
+/* ===== Function Description:
+	Load the plan of a circuit into a new frontend.
+	The precision, the mode, and the single-gate cost are taken from the plan, and the other settings are kept.
+	The blocks with final plans are exported without optimizing, and the ones with checkpoints resume their optimization.
+	Return false with a message if the plan is malformed.
+*/
+bool Frontend::importPlan(const string& file_name, string& message) {
+	BinaryFile file(file_name);
+	message = "malformed plan";
+	if (file.getKind() != BINARYKIND::PLAN) return false;
+	PlanReader reader(file.getData() + BINARY_HEADER_SIZE, file.getSize() - BINARY_HEADER_SIZE);
+	int precision = reader.number(INT_MAX);
+	double cost_single = reader.real();
+	bool is_same = reader.byte() != 0;
+	if (precision == 0) return false;
+	_is_plan_imported = true;
+	_config = Config(precision, cost_single, is_same, _config.getAdderType(), _config.getCostToffoli(), _config.getDepthToffoli(), _config.getLookupWidth(), _config.getPhasingType());
+
+	int n_headers = reader.count();
+	for (int k = 0; k < n_headers; ++k) {
+		_headers.emplace_back(reader.text());
+	}
+
+	int n_gates = reader.count();
+	for (int id = 0; id < n_gates && reader.isValid(); ++id) {
+		GateSpec gate;
+		int gate_type = reader.byte();
+		if (gate_type > GATETYPE::CP) return false;
+		gate.type = (GATETYPE)gate_type;
+		int n_qubits = reader.number(2);
+		for (int k = 0; k < n_qubits; ++k) {
+			gate.qubits.emplace_back(reader.number(INT_MAX));
+		}
+		gate.angle.is_exact = reader.byte() != 0;
+		gate.angle.numerator = reader.signedVarint();
+		gate.angle.log_denominator = reader.number(64);
+		gate.angle.radians = reader.real();
+		gate.max_error = reader.real();
+		_gates.emplace_back(gate);
+	}
+
+	vector<int> stored_ids;		// block id in the plan of each block segment
+	_gate_segments.assign(_gates.size(), -1);
+	for (unsigned int k = 0; k < file.getNumRecords() && reader.isValid(); ++k) {
+		Segment segment;
+		int block_id = reader.number(INT_MAX) - 1;
+		if (block_id == -1) {
+			segment.line = reader.text();
+			_segments.emplace_back(segment);
+			continue;
+		}
+		int n_gates = reader.count();
+		for (int k = 0; k < n_gates; ++k) {
+			segment.gate_ids.emplace_back(reader.number((long long)_gates.size() - 1));
+		}
+		if (n_gates == 0 || !reader.isValid()) return false;
+		for (int id : segment.gate_ids) {
+			if (_gate_segments[id] != -1) return false;
+			_gate_segments[id] = _segments.size();
+		}
+		stored_ids.emplace_back(block_id);
+		_segments.emplace_back(segment);
+	}
+
+	vector<string> plans(reader.count());
+	for (string& plan : plans) {
+		plan = reader.text();
+	}
+	if (!reader.isEnd() || find(_gate_segments.begin(), _gate_segments.end(), -1) != _gate_segments.end()) return false;
+
+	_block_plans.clear();
+	int n_block_segments = 0;
+	for (Segment& segment : _segments) {
+		if (!segment.gate_ids.empty()) {
+			int stored_id = stored_ids[n_block_segments++];
+			if (stored_id >= plans.size()) return false;
+			if (assignBlock(segment)) _block_plans.emplace_back(plans[stored_id]);
+		}
+	}
+	return true;
+}
@@ -1,12 +1,11 @@
 #include "headers.h"
 
-float COST_TOFFOLI = 4;
 
 /* ===== Function Description:  // O(k)
 	Calculate the combination number of (n, k).
+	The result saturates at LLONG_MAX instead of overflowing.
 */
-int nCr(int n, int k) {
-	int x = M_PI;
+long long nCr(int n, int k) {
 	if (n < k) {
 		return 0;
 	}
@@ -14,41 +13,350 @@ int nCr(int n, int k) {
 		k = n - k;
 	}
 
-	int ans = 1;
+	long long ans = 1;
 	for (int i = 1; i <= k; i++) {
-		ans *= n;
-		ans /= i;
-		n--;
+		__int128 next = (__int128)ans * (n - k + i) / i;	// C(n - k + i, i), exact
+		if (next > LLONG_MAX) return LLONG_MAX;
+		ans = next;
 	}
 	return ans;
 }
 
-/* ===== Function Description:  // O(1)
+/* ===== Function Description:  // O(n_bits * log(n_bits))
+	Build the in-place carry-lookahead adder y <- x + y (mod 2^n_bits) in [T. G. Draper et al., 2004].
+	Wire j is x_j, wire (n_bits + j) is y_j (bit 0 is the LSB), and the other wires are ancillas initialized to 0.
+	The carries are computed into ancillas in logarithmic depth and added to y.
+	Then they are uncomputed from x and the complement of the sum, which generate the same carries.
+	Return the number of ancillas.
+*/
+int buildPrefixAdder(int n_bits, vector<NetGate>& gates) {
+	gates.clear();
+	int m = n_bits - 1;				// the carries c_1, ..., c_m into bits 1, ..., m are needed
+	int n_wires = 2 * n_bits;
+	vector<int> x(n_bits), y(n_bits), z(m + 1, -1);	// z[i] is the ancilla of c_i
+	for (int j = 0; j < n_bits; ++j) {
+		x[j] = j;
+		y[j] = n_bits + j;
+	}
+	for (int i = 1; i <= m; ++i) {
+		z[i] = n_wires++;
+	}
+
+	int log_m = 0;					// floor(log2(m))
+	while ((2 << log_m) <= m) log_m++;
+	int log_c = 0;					// floor(log2(2m/3))
+	while ((2 << log_c) <= 2 * m / 3) log_c++;
+
+	// p[t][k]: the propagate bit of bits [k * 2^t, (k + 1) * 2^t), where p[0] is y after y ^= x
+	vector<vector<int>> p(max(log_m, 1));
+	p[0] = y;
+	vector<NetGate> rounds;
+	for (int t = 1; t < log_m; ++t) {	// P-rounds
+		p[t] = vector<int>(m >> t, -1);
+		for (int k = 1; k < (m >> t); ++k) {
+			p[t][k] = n_wires++;
+			rounds.emplace_back(vector<int>{ p[t - 1][2 * k], p[t - 1][2 * k + 1], p[t][k] });
+		}
+	}
+	int n_p_gates = rounds.size();
+	for (int t = 1; t <= log_m; ++t) {	// G-rounds
+		for (int k = 0; k < (m >> t); ++k) {
+			rounds.emplace_back(vector<int>{ p[t - 1][2 * k + 1], z[(k << t) + (1 << (t - 1))], z[(k + 1) << t] });
+		}
+	}
+	for (int t = (2 * m / 3 > 0) ? log_c : 0; t >= 1; --t) {	// C-rounds
+		for (int k = 1; k <= ((m - (1 << (t - 1))) >> t); ++k) {
+			rounds.emplace_back(vector<int>{ p[t - 1][2 * k], z[k << t], z[(k << t) + (1 << (t - 1))] });
+		}
+	}
+	for (int i = n_p_gates - 1; i >= 0; --i) {	// P^-1-rounds
+		vector<int> wires = rounds[i].wires;
+		rounds.emplace_back(wires, true);
+	}
+
+	// compute the carries and the sum
+	for (int j = 0; j < m; ++j) gates.emplace_back(vector<int>{ x[j], y[j], z[j + 1] });
+	for (int j = 0; j < n_bits; ++j) gates.emplace_back(vector<int>{ x[j], y[j] });
+	gates.insert(gates.end(), rounds.begin(), rounds.end());
+	for (int j = 1; j < n_bits; ++j) gates.emplace_back(vector<int>{ z[j], y[j] });
+
+	// uncompute the carries by the reverted circuit on x and ~y
+	for (int j = 0; j < m; ++j) gates.emplace_back(vector<int>{ y[j] });
+	for (int j = 0; j < m; ++j) gates.emplace_back(vector<int>{ x[j], y[j] });
+	for (int i = rounds.size() - 1; i >= 0; --i) {
+		NetGate gate = rounds[i];
+		if (gate.wires.back() > z[m]) gate.is_uncompute = !gate.is_uncompute;	// P-rounds and P^-1-rounds are swapped
+		gates.emplace_back(gate);
+	}
+	for (int j = 0; j < m; ++j) gates.emplace_back(vector<int>{ x[j], y[j] });
+	for (int j = 0; j < m; ++j) gates.emplace_back(vector<int>{ x[j], y[j], z[j + 1] }, true);
+	for (int j = 0; j < m; ++j) gates.emplace_back(vector<int>{ y[j] });
+
+	return n_wires - 2 * n_bits;
+}
+
+/* ===== Function Description:  // O(#inputs)
+	Build the network computing the Hamming weight of the input bits by full and half adders (Hamming-weight phasing [C. Gidney, 2018]).
+	'levels[j]' lists the input wires of weight 2^j, which are wires 0, ..., n_inputs - 1 (a wire listed again is copied into an ancilla first).
+	A full adder on (a, b, c) writes the sum into c and the carry into a new ancilla by one logical-AND gate,
+	and a half adder on (a, b) writes the sum into b and the carry into a new ancilla,
+	so n distinct inputs of weight 1 take n - popcount(n) logical-AND gates.
+	Only the bits below 2^n_levels are kept: inputs of higher weights are ignored, and the top level is summed by CNOT gates without carries.
+	The wire of the j-th bit of the weight is stored in 'weights[j]' (-1 if the bit is always 0).
+	The network is uncomputed by the reverted one, whose logical-AND gates clear their targets.
+	Return the number of ancillas.
+*/
+int buildHammingTree(const vector<vector<int>>& levels, int n_inputs, vector<NetGate>& gates, vector<int>& weights, int n_levels) {
+	gates.clear();
+	weights.clear();
+	int n_wires = n_inputs;
+	vector<bool> is_listed(n_inputs, false);
+	vector<deque<int>> queues(min((int)levels.size(), n_levels));
+	for (int j = 0; j < queues.size(); ++j) {
+		for (int wire : levels[j]) {
+			if (is_listed[wire]) {
+				gates.emplace_back(vector<int>{ wire, n_wires });
+				wire = n_wires++;
+			}
+			else {
+				is_listed[wire] = true;
+			}
+			queues[j].emplace_back(wire);
+		}
+	}
+
+	for (int j = 0; j < queues.size(); ++j) {
+		while (queues[j].size() > 1 && j + 1 == n_levels) {		// the carries are full turns
+			int a = queues[j].front();
+			queues[j].pop_front();
+			gates.emplace_back(vector<int>{ a, queues[j].front() });
+		}
+		while (queues[j].size() > 1) {
+			if (j + 1 == queues.size()) queues.emplace_back();
+			int carry = n_wires++;
+			int a = queues[j].front();
+			queues[j].pop_front();
+			int b = queues[j].front();
+			queues[j].pop_front();
+			if (!queues[j].empty()) {	// full adder
+				int c = queues[j].front();
+				queues[j].pop_front();
+				gates.emplace_back(vector<int>{ a, b });
+				gates.emplace_back(vector<int>{ a, c });
+				gates.emplace_back(vector<int>{ b, c, carry });		// (a ^ b)(a ^ c)
+				gates.emplace_back(vector<int>{ a, carry });		// majority
+				gates.emplace_back(vector<int>{ b, c });
+				gates.emplace_back(vector<int>{ a, c });			// a ^ b ^ c
+				gates.emplace_back(vector<int>{ a, b });
+				queues[j].emplace_back(c);
+			}
+			else {						// half adder
+				gates.emplace_back(vector<int>{ a, b, carry });
+				gates.emplace_back(vector<int>{ a, b });
+				queues[j].emplace_back(b);
+			}
+			queues[j + 1].emplace_back(carry);
+		}
+		weights.emplace_back(queues[j].empty() ? -1 : queues[j].front());
+	}
+	return n_wires - n_inputs;
+}
+
+/* ===== Function Description:  // O(#gates)
+	Count the Toffoli gates and the Toffoli depth of a network.
+	Toffoli gates clearing their targets are not counted.
+*/
+void countNetworkToffoli(const vector<NetGate>& gates, int n_wires, int& n_toffoli, int& toffoli_depth) {
+	n_toffoli = 0;
+	toffoli_depth = 0;
+	vector<int> depth(n_wires, 0);
+	for (const NetGate& gate : gates) {
+		int gate_depth = 0;
+		for (int wire : gate.wires) gate_depth = max(gate_depth, depth[wire]);
+		if (gate.wires.size() == 3 && !gate.is_uncompute) {
+			gate_depth++;
+			n_toffoli++;
+		}
+		for (int wire : gate.wires) depth[wire] = gate_depth;
+		toffoli_depth = max(toffoli_depth, gate_depth);
+	}
+}
+
+/* ===== Function Description:  // O(1) for ripple-carry adders, O(min_bit * log(min_bit)) for carry-lookahead adders
+	Calculate the number of Toffoli gates and the Toffoli depth of an adder circuit on bits [0, min_bit].
+*/
+void countAdderToffoli(int min_bit, ADDERTYPE adder_type, int& n_toffoli, int& toffoli_depth) {
+	if (adder_type == ADDERTYPE::RIPPLE) {
+		n_toffoli = ((min_bit - 0 + 1) - 1);
+		toffoli_depth = n_toffoli;
+		return;
+	}
+	vector<NetGate> gates;
+	int n_ancilla = buildPrefixAdder(min_bit + 1, gates);
+	countNetworkToffoli(gates, 2 * (min_bit + 1) + n_ancilla, n_toffoli, toffoli_depth);
+}
+
+/* ===== Function Description:
+	Estimate the T-count of applying a single-qubit rotation with 'precision' bits,
+	as the cheapest of the HST, RUS, and PQF synthesis methods, rounded up to whole T gates.
+*/
+float countSingleCost(int precision) {
+	float HST = 3.0 * (precision + 1) + log2(precision + 1);
+	float RUS = 1.149 * (precision + 1) + 9.2;
+	float PQF = 1.0 * (precision + 1) + 4 * log2(precision + 1) + 1.187;
+	return ceil(min(HST, min(RUS, PQF)));
+}
+
+float Config::getCostSingle(int precision) const {
+	return isCostModel() ? countSingleCost(min(precision, _precision)) : _cost_single;
+}
+
+/* ===== Function Description:
 	Calculate the cost of an adder circuit.
 */
-int countAdderCost(int min_bit) {
-	int n_toffoli = ((min_bit - 0 + 1) - 1);
-	int t_count = n_toffoli * COST_TOFFOLI;
-	return t_count;
+float countAdderCost(int min_bit, const Config& config) {
+	int n_toffoli, toffoli_depth;
+	countAdderToffoli(min_bit, config.getAdderType(), n_toffoli, toffoli_depth);
+	return n_toffoli * config.getCostToffoli();
 }
 
-/* ===== Function Description:  // O(min(log(counter_size), dis_to_head))
-	Calculate the cost of a counter circuit.
+/* ===== Function Description:
+	Calculate the T-depth of an adder circuit.
+*/
+float countAdderDepth(int min_bit, const Config& config) {
+	int n_toffoli, toffoli_depth;
+	countAdderToffoli(min_bit, config.getAdderType(), n_toffoli, toffoli_depth);
+	return toffoli_depth * config.getDepthToffoli();
+}
+
+/* ===== Function Description:  // O(min(log(counter_size), dis_to_head) * log(counter_size))
+	Calculate the number of Toffoli gates of a counter circuit.
 	Note that by storing target bits of previous k/2-controlled Toffoli gates,
-	k-controlled Toffoli gates with k > 2 can be obtained by a single 2-controlled Toffoli gate.
+	k-controlled Toffoli gates with k > 2 can be obtained by a single 2-controlled Toffoli gate
+	(see 'planProducts', which also shares equal products, so this is an upper bound of the written circuit).
+	The result saturates at LLONG_MAX instead of overflowing.
 */
-int countCounterCost(int counter_size, int dis_to_head) {
-	int n_toffoli = 0;
+long long countCounterToffoli(int counter_size, int dis_to_head) {
+	long long n_toffoli = 0;
 
 	int comb = 2;
 	while (comb <= counter_size && dis_to_head > 0) {
-		n_toffoli += nCr(counter_size, comb);
+		long long n_comb = nCr(counter_size, comb);
+		n_toffoli = (n_comb > LLONG_MAX - n_toffoli) ? LLONG_MAX : n_toffoli + n_comb;
 		comb *= 2;
 		dis_to_head--;
 	}
 	// recover circuit has no cost by the previous method 
 
-	return n_toffoli * COST_TOFFOLI;
+	return n_toffoli;
+}
+
+/* ===== Function Description:  // O(1)
+	Calculate the number of Toffoli gates of a table lookup over 'width' address bits and its unlookup.
+	Each is a unary iteration [R. Babbush et al., 2018] computing 2^width - 2 logical-AND gates,
+	whose uncomputations cost no T gate, and the entries are loaded by CNOT gates.
+*/
+long long countLookupToffoli(int width) {
+	return 2 * ((1LL << width) - 2);
+}
+
+/* ===== Function Description:
+	Calculate the cost of a counter circuit.
+*/
+float countCounterCost(int counter_size, int dis_to_head, const Config& config) {
+	return countCounterToffoli(counter_size, dis_to_head) * config.getCostToffoli();
+}
+
+/* ===== Function Description:  // O(max_counter_size * log(max_counter_size)^2 + precision^2 * log(precision))
+	Constructor of the 'CostModel' class.
+	Precompute the adder costs and depths up to the precision of 'config' and the counter costs up to 'max_counter_size',
+	so that the cost queries of the optimizer are table reads.
+*/
+CostModel::CostModel(const Config& config, int max_counter_size) : _cost_toffoli(config.getCostToffoli()), _depth_toffoli(config.getDepthToffoli()), _adder_type(config.getAdderType()) {
+	int precision = config.getPrecision();
+	_max_counter_size = max(max_counter_size, 2);
+	_max_level = log2(_max_counter_size);
+
+	_adder_costs = vector<float>(max(precision, 1));
+	_adder_depths = vector<float>(max(precision, 1));
+	for (int i = 0; i < _adder_costs.size(); ++i) {
+		int n_toffoli, toffoli_depth;
+		countAdderToffoli(i, _adder_type, n_toffoli, toffoli_depth);
+		_adder_costs[i] = n_toffoli * _cost_toffoli;
+		_adder_depths[i] = toffoli_depth * _depth_toffoli;
+	}
+
+	// the counter cost only depends on min(dis_to_head, floor(log2(counter_size)))
+	_counter_costs = vector<vector<float>>(_max_counter_size + 1, vector<float>(_max_level + 1, 0));
+	_marginal_costs = vector<vector<float>>(_max_counter_size + 1, vector<float>(_max_level + 1, 0));
+	vector<long long> prev_toffoli(_max_level + 1, 0);
+	for (int counter_size = 1; counter_size <= _max_counter_size; ++counter_size) {
+		for (int level = 0; level <= _max_level; ++level) {
+			long long n_toffoli = countCounterToffoli(counter_size, level);
+			long long n_marginal = (n_toffoli == LLONG_MAX) ? LLONG_MAX : n_toffoli - prev_toffoli[level];
+			_counter_costs[counter_size][level] = n_toffoli * _cost_toffoli;
+			_marginal_costs[counter_size][level] = n_marginal * _cost_toffoli;
+			prev_toffoli[level] = n_toffoli;
+		}
+	}
+}
+
+/* ===== Function Description:  // O(1)
+	Get the cost of an adder circuit.
+*/
+float CostModel::adderCost(int min_bit) const {
+	if (min_bit >= _adder_costs.size()) {
+		int n_toffoli, toffoli_depth;
+		countAdderToffoli(min_bit, _adder_type, n_toffoli, toffoli_depth);
+		return n_toffoli * _cost_toffoli;
+	}
+	return _adder_costs[min_bit];
+}
+
+/* ===== Function Description:  // O(1)
+	Get the T-depth of an adder circuit.
+*/
+float CostModel::adderDepth(int min_bit) const {
+	if (min_bit >= _adder_depths.size()) {
+		int n_toffoli, toffoli_depth;
+		countAdderToffoli(min_bit, _adder_type, n_toffoli, toffoli_depth);
+		return toffoli_depth * _depth_toffoli;
+	}
+	return _adder_depths[min_bit];
+}
+
+/* ===== Function Description:  // O(1)
+	Get the cost of a counter circuit.
+*/
+float CostModel::counterCost(int counter_size, int dis_to_head) const {
+	if (counter_size > _max_counter_size) return countCounterToffoli(counter_size, dis_to_head) * _cost_toffoli;
+	return _counter_costs[counter_size][min(dis_to_head, _max_level)];
+}
+
+/* ===== Function Description:  // O(1)
+	Get the extra cost of increasing the counter size from 'counter_size' - 1 to 'counter_size'.
+*/
+float CostModel::counterMarginalCost(int counter_size, int dis_to_head) const {
+	if (counter_size > _max_counter_size) {
+		long long n_toffoli = countCounterToffoli(counter_size, dis_to_head);
+		if (n_toffoli == LLONG_MAX) return n_toffoli * _cost_toffoli;
+		return (n_toffoli - countCounterToffoli(counter_size - 1, dis_to_head)) * _cost_toffoli;
+	}
+	return _marginal_costs[counter_size][min(dis_to_head, _max_level)];
+}
+
+/* ===== Function Description:  // O(1)
+	Get the cost of a table lookup and its unlookup, where the adder is not included.
+*/
+float CostModel::lookupCost(int width) const {
+	return countLookupToffoli(width) * _cost_toffoli;
+}
+
+/* ===== Function Description:  // O(1)
+	Get the T-depth of a table lookup and its unlookup, whose logical-AND gates are applied one by one.
+*/
+float CostModel::lookupDepth(int width) const {
+	return countLookupToffoli(width) * _depth_toffoli;
 }
 
 /* ===== Function Description:
@@ -76,3 +384,97 @@ void boothEncode(vector<int>& bit_string) {
 		}
 	}
 }
+
+/* ===== Function Description:
+	Run job(0), ..., job(n_jobs - 1) on 'n_threads' threads (0: all hardware threads).
+*/
+void parallelFor(int n_jobs, int n_threads, const function<void(int)>& job) {
+	if (n_threads <= 0) n_threads = thread::hardware_concurrency();
+	n_threads = max(1, min(n_threads, n_jobs));
+	if (n_threads == 1) {
+		for (int i = 0; i < n_jobs; ++i) job(i);
+		return;
+	}
+
+	atomic<int> next_job(0);
+	vector<thread> workers;
+	for (int t = 0; t < n_threads; ++t) {
+		workers.emplace_back([&]() {
+			for (int i = next_job++; i < n_jobs; i = next_job++) job(i);
+		});
+	}
+	for (thread& worker : workers) worker.join();
+}
+
+/* ===== Function Description:
+	Constructor of the 'WorkStealingPool' class with 'n_threads' threads (0: all hardware threads).
+*/
+WorkStealingPool::WorkStealingPool(int n_threads) : _n_threads((n_threads <= 0) ? thread::hardware_concurrency() : n_threads) {
+	_n_threads = max(1, _n_threads);
+	_queues = vector<deque<function<void(int)>>>(_n_threads);
+	_mutexes = vector<mutex>(_n_threads);
+}
+
+/* ===== Function Description:
+	Add a task to the queue of thread 'worker'.
+*/
+void WorkStealingPool::push(int worker, const function<void(int)>& task) {
+	_n_pending++;
+	lock_guard<mutex> lock(_mutexes[worker]);
+	_queues[worker].emplace_back(task);
+}
+
+/* ===== Function Description:
+	Take the newest task of thread 'worker', or steal the oldest task of another thread.
+	Return false if all queues are empty.
+*/
+bool WorkStealingPool::pop(int worker, function<void(int)>& task) {
+	for (int k = 0; k < _n_threads; ++k) {
+		int victim = (worker + k) % _n_threads;
+		lock_guard<mutex> lock(_mutexes[victim]);
+		if (_queues[victim].empty()) continue;
+		if (k == 0) {
+			task = move(_queues[victim].back());
+			_queues[victim].pop_back();
+		}
+		else {
+			task = move(_queues[victim].front());
+			_queues[victim].pop_front();
+		}
+		return true;
+	}
+	return false;
+}
+
+/* ===== Function Description:
+	Run the tasks on the threads until no task is pending.
+*/
+void WorkStealingPool::run() {
+	auto work = [this](int worker) {
+		function<void(int)> task;
+		bool is_idle = false;
+		while (_n_pending > 0) {
+			if (!pop(worker, task)) {
+				if (!is_idle) _n_idle++;
+				is_idle = true;
+				this_thread::yield();
+				continue;
+			}
+			if (is_idle) _n_idle--;
+			is_idle = false;
+			task(worker);
+			_n_pending--;
+		}
+		if (is_idle) _n_idle--;
+	};
+
+	if (_n_threads == 1) {
+		work(0);
+		return;
+	}
+	vector<thread> workers;
+	for (int t = 0; t < _n_threads; ++t) {
+		workers.emplace_back(work, t);
+	}
+	for (thread& worker : workers) worker.join();
+}
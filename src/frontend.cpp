@@ -0,0 +1,939 @@
+#include "headers.h"
+
+/* ===== Function Description:
+	Read a Clifford+rotation openQASM circuit.
+	Rotation gates are collected into maximal blocks of mutually commuting rotations,
+	where each qubit is used with a single rotation axis.
+	A rotation joins a block being parsed if it commutes with all gates parsed after the block (see 'addRotation').
+	Other gates pass through unchanged, and "barrier" closes the blocks.
+*/
+void Frontend::importQasm(const string& file_name) {
+	ifstream in_file(file_name, ios::in);
+	if (!in_file.good()) {
+		cerr << "File \"" << file_name << "\" is not found\n";
+		exit(-1);
+	}
+
+	string line;
+	while (getline(in_file, line)) {
+		importLine(line);
+	}
+	closeLayer();
+}
+
+/* ===== Function Description:
+	Read a circuit in the binary formats (see 'binary.cpp').
+	The rotations of a rotation layer are added without text parsing,
+	and the records of a streamed circuit are read as openQASM lines.
+	A plan is loaded with the plans of its blocks (see 'importPlan').
+*/
+void Frontend::importBinary(const string& file_name) {
+	BinaryFile file(file_name);
+	string message;
+	if (file.getKind() == BINARYKIND::PLAN) {
+		if (!importPlan(file_name, message)) {
+			cerr << "[Error]: File \"" << file_name << "\": " << message << "." << endl;
+			exit(-1);
+		}
+	}
+	else if (file.getKind() == BINARYKIND::ROTATIONS) {
+		vector<GateSpec> gates;
+		int n_qubits = readBinaryRotations(file, gates);
+		if (n_qubits < 0) {
+			cerr << "[Error]: File \"" << file_name << "\" has malformed rotation records." << endl;
+			exit(-1);
+		}
+		_headers.emplace_back("OPENQASM 2.0;");
+		_headers.emplace_back("include \"qelib1.inc\";");
+		_headers.emplace_back("qreg q[" + to_string(n_qubits) + "];");
+		for (GateSpec& gate : gates) {
+			addRotation(gate);
+		}
+	}
+	else {
+		if (!readBinaryCircuit(file, [this](const string& line) { importLine(line); }, message)) {
+			cerr << "[Error]: File \"" << file_name << "\": " << message << "." << endl;
+			exit(-1);
+		}
+	}
+	closeLayer();
+}
+
+/* ===== Function Description:
+	Read a line of a Clifford+rotation openQASM circuit.
+	The qubits are identified by their indices in the only quantum register, which must be "q",
+	since the synthesized circuit names the data qubits "q[i]" (see 'addPassThrough').
+*/
+void Frontend::importLine(const string& qasm_line) {
+	string line = qasm_line.substr(0, qasm_line.find("//"));
+	if (line.find_first_not_of("\t\n\r ") == string::npos) return;
+
+	string word = line.substr(0, line.find_first_of(" (\t"));
+	if (_in_gate_definition || word == "gate" || word == "opaque") {	// custom gate definitions are kept in the headers
+		_headers.emplace_back(line);
+		if (word == "gate" || _in_gate_definition) _in_gate_definition = (line.find('}') == string::npos);
+		return;
+	}
+
+	GateSpec gate;
+	if (parseRotation(line, gate.type, gate.angle, gate.qubits)) {
+		size_t annotation = qasm_line.find("error=", line.size());		// e.g., "rz(0.3) q[0]; // error=1e-4"
+		if (annotation != string::npos) {
+			const char* begin = qasm_line.c_str() + annotation + 6;
+			char* end;
+			gate.max_error = strtod(begin, &end);
+			if (end == begin || gate.max_error < 0) {
+				cerr << "[Error]: Invalid error annotation in \"" << qasm_line << "\"." << endl;
+				exit(-1);
+			}
+		}
+		addRotation(gate);
+	}
+	else if (word == "qreg" || word == "creg" || word == "OPENQASM" || word == "include") {
+		if (word == "qreg") {
+			string name = line.substr(4, line.find('[') - 4);
+			name.erase(remove_if(name.begin(), name.end(), ::isspace), name.end());
+			if (name != "q" || _has_qreg) {
+				cerr << "[Error]: The circuit must have a single quantum register named \"q\", but \"" << line << "\" is found." << endl;
+				exit(-1);
+			}
+			_has_qreg = true;
+		}
+		_headers.emplace_back(line);
+	}
+	else {
+		addPassThrough(line);
+	}
+}
+
+/* ===== Function Description:
+	Add a rotation gate to the earliest block being parsed that it can join, or to a new block if it cannot join the last one.
+	A gate joining an earlier block moves over the later blocks, since it can join a block only if it commutes with the block and the gates after it.
+	With more than one block being parsed (see 'setMaxLayers'), the blocks of different rotation axes are built side by side,
+	so that a circuit mixing the axes on some qubits is not cut into a block at every change of the axis.
+	The oldest block is closed when there are too many.
+*/
+void Frontend::addRotation(const GateSpec& gate) {
+	int target = -1;
+	for (int k = _layers.size() - 1; k >= 0 && canJoinLayer(_layers[k], gate); --k) {
+		target = k;
+	}
+	if (target == -1) {
+		_layers.emplace_back();
+		if (_layers.size() > _max_layers) flushLayer();
+		target = _layers.size() - 1;
+	}
+
+	Layer& layer = _layers[target];
+	for (int qubit : gate.qubits) {
+		layer.axis[qubit] = getAxis(gate.type);
+	}
+	layer.gate_ids.emplace_back(_gates.size());
+	_gates.emplace_back(gate);
+}
+
+/* ===== Function Description:
+	Check whether a rotation gate can join a block being parsed,
+	i.e., it commutes with the rotations of the block and the pass-through gates after it.
+*/
+bool Frontend::canJoinLayer(const Layer& layer, const GateSpec& gate) {
+	const char axis_type[3] = { 'x', 'y', 'z' };
+	int axis = getAxis(gate.type);
+	for (int qubit : gate.qubits) {
+		auto it = layer.axis.find(qubit);
+		if (it != layer.axis.end() && it->second != axis) {
+			return false;
+		}	// different rotation-axis type
+		auto type_it = layer.pending_type.find(qubit);
+		if (type_it != layer.pending_type.end() && type_it->second != axis_type[axis]) {
+			return false;
+		}	// does not commute with a pass-through gate
+	}
+	return true;
+}
+
+/* ===== Function Description:
+	Get the Pauli type of a Clifford gate on its operand, i.e.,
+	the gate only contains I and the returned Pauli on the operand.
+	Return 'n' if there is no such Pauli.
+*/
+char getPauliType(const string& gate_name, int operand_index) {
+	if (gate_name == "x" || gate_name == "sx" || gate_name == "sxdg") return 'x';
+	if (gate_name == "y") return 'y';
+	if (gate_name == "z" || gate_name == "s" || gate_name == "sdg" || gate_name == "t" || gate_name == "tdg" || gate_name == "u1") return 'z';
+	if (gate_name == "cz" || gate_name == "cu1") return 'z';
+	if (gate_name == "cx" || gate_name == "CX") return (operand_index == 0) ? 'z' : 'x';
+	if (gate_name == "cy") return (operand_index == 0) ? 'z' : 'y';
+	if (gate_name == "ccx") return (operand_index < 2) ? 'z' : 'x';
+	return 'n';
+}
+
+/* ===== Function Description:
+	Add a non-rotation line after the blocks being parsed.
+	Lines using the whole data register (e.g., "barrier q;") close the blocks.
+	The operands "q[i]" are the only qubits, since the circuit has no other quantum register (see 'importLine').
+*/
+void Frontend::addPassThrough(const string& line) {
+	string gate_name = line.substr(0, line.find_first_of(" (\t"));
+	vector<int> qubits;
+	bool whole_register = (gate_name == "barrier");
+	for (size_t pos = line.find('q'); pos != string::npos; pos = line.find('q', pos + 1)) {
+		bool is_begin = (pos == 0 || !(isalnum(line[pos - 1]) || line[pos - 1] == '_'));
+		bool is_end = (pos + 1 == line.size() || !(isalnum(line[pos + 1]) || line[pos + 1] == '_'));
+		if (!is_begin || !is_end) continue;
+
+		size_t next = line.find_first_not_of(" \t", pos + 1);
+		if (next != string::npos && line[next] == '[') {
+			qubits.emplace_back(stoi(line.substr(next + 1)));
+		}
+		else {
+			whole_register = true;
+		}
+	}
+
+	if (whole_register) {
+		closeLayer();
+		Segment segment;
+		segment.line = line;
+		_segments.emplace_back(segment);
+		return;
+	}
+
+	Layer& layer = _layers.back();
+	layer.pending.emplace_back(line);
+	for (int i = 0; i < qubits.size(); ++i) {
+		char type = getPauliType(gate_name, i);
+		if (layer.pending_type.count(qubits[i]) > 0 && layer.pending_type[qubits[i]] != type) {
+			type = 'n';
+		}
+		layer.pending_type[qubits[i]] = type;
+	}
+}
+
+/* ===== Function Description:
+	Close the oldest block being parsed, followed by its pass-through lines.
+*/
+void Frontend::flushLayer() {
+	Layer& layer = _layers.front();
+	if (!layer.gate_ids.empty()) {
+		Segment segment;
+		segment.gate_ids = layer.gate_ids;
+		assignBlock(segment);
+		_gate_segments.resize(_gates.size(), -1);
+		for (int id : segment.gate_ids) {
+			_gate_segments[id] = _segments.size();
+		}
+		_segments.emplace_back(segment);
+	}
+
+	for (string& line : layer.pending) {
+		Segment segment;
+		segment.line = line;
+		_segments.emplace_back(segment);
+	}
+	_layers.pop_front();
+}
+
+/* ===== Function Description:
+	Close all the blocks being parsed.
+*/
+void Frontend::closeLayer() {
+	while (!_layers.empty()) {
+		flushLayer();
+	}
+	_layers.emplace_back();
+}
+
+/* ===== Function Description:
+	Get the number of bits of a rotation gate: the lowest one within its tolerated error, or the precision of the config.
+	The same angles of the special case are not truncated.
+*/
+int Frontend::gatePrecision(const GateSpec& gate) {
+	if (_config.isSame()) return _config.getPrecision();
+	return precisionForError(gate.angle, gate.max_error, _config.getPrecision());
+}
+
+/* ===== Function Description:
+	Assign the distinct block of a segment from its rotation gates.
+	The gates are fingerprinted with canonical qubit indices and rounded angles,
+	so that repeated blocks share one synthesized circuit.
+	Return true if a new distinct block is added.
+*/
+bool Frontend::assignBlock(Segment& segment) {
+	unordered_map<int, int> canonical;		// qubit index -> canonical qubit index
+	vector<GateSpec> block;
+	string fingerprint;
+	vector<int> bit_string;
+	segment.qubit_map.clear();
+	for (int id : segment.gate_ids) {
+		GateSpec& gate = _gates[id];
+		GateSpec canonical_gate = gate;
+		fingerprint += to_string(gate.type) + "(";
+		for (int& qubit : canonical_gate.qubits) {
+			if (canonical.count(qubit) == 0) {
+				canonical[qubit] = segment.qubit_map.size();
+				segment.qubit_map.emplace_back(qubit);
+			}
+			qubit = canonical[qubit];
+			fingerprint += to_string(qubit) + ",";
+		}
+		int precision = gatePrecision(gate);
+		angleToBits(gate.angle, precision, bit_string);
+		for (int bit : bit_string) {
+			fingerprint += (char)('0' + bit);
+		}
+		if (precision != _config.getPrecision()) fingerprint += "/" + to_string(precision);
+		fingerprint += ")";
+		block.emplace_back(canonical_gate);
+	}
+
+	auto it = _fingerprints.find(fingerprint);
+	if (it != _fingerprints.end()) {
+		segment.block_id = it->second;
+		return false;
+	}
+	segment.block_id = _blocks.size();
+	_fingerprints[fingerprint] = segment.block_id;
+	_blocks.emplace_back(block);
+	_block_fingerprints.emplace_back(fingerprint);
+	return true;
+}
+
+/* ===== Function Description:
+	Update the angles of rotation gates given as (gate id, angle) pairs, where gate ids follow the input order.
+	Only the blocks containing updated gates are fingerprinted again;
+	a block is synthesized again by the next 'estimate' or 'exportQasm' only if its rounded angles match no existing distinct block,
+	and then as a whole, without the moves of its unchanged gates.
+	Return the number of new distinct blocks.
+*/
+int Frontend::updateAngles(const vector<pair<int, Angle>>& updates) {
+	set<int> updated_segments;
+	for (const pair<int, Angle>& update : updates) {
+		if (update.first < 0 || update.first >= _gates.size()) {
+			cerr << "[Error]: Gate " << update.first << " is not found." << endl;
+			exit(-1);
+		}
+		_gates[update.first].angle = update.second;
+		updated_segments.insert(_gate_segments[update.first]);
+	}
+
+	int n_new_blocks = 0;
+	for (int i : updated_segments) {
+		if (assignBlock(_segments[i])) n_new_blocks++;
+	}
+	removeUnusedBlocks();
+	return n_new_blocks;
+}
+
+/* ===== Function Description:
+	Get the output file name of a point in the sweep mode, by appending the point index to the stem (e.g., "out.qasm" -> "out_3.qasm").
+*/
+string pointFileName(const string& file_name, int point) {
+	size_t dot = file_name.find_last_of('.');
+	size_t slash = file_name.find_last_of('/');
+	if (dot == string::npos || (slash != string::npos && dot < slash)) dot = file_name.size();
+	return file_name.substr(0, dot) + "_" + to_string(point) + file_name.substr(dot);
+}
+
+/* ===== Function Description:
+	Synthesize the circuit for each point of a parameter sweep, where a point is the vector of angles of all the rotation gates in input order.
+	The circuit is parsed only once: the points are split into contiguous chunks over the threads,
+	and each chunk updates a copy of this frontend point by point, so only the blocks with changed angles are synthesized again.
+	If 'out_file_name' is not empty, the circuit of point k is exported to 'pointFileName(out_file_name, k)'.
+	Return the statistics of the points, and the numbers of distinct blocks in 'n_blocks'.
+*/
+vector<Estimate> Frontend::sweep(const vector<vector<Angle>>& points, const string& out_file_name, bool is_binary, vector<int>& n_blocks) {
+	for (int k = 0; k < points.size(); ++k) {
+		if (points[k].size() != _gates.size()) {
+			cerr << "[Error]: Point " << k << " has " << points[k].size() << " angles, but the circuit has " << _gates.size() << " rotation gates." << endl;
+			exit(-1);
+		}
+	}
+
+	vector<Estimate> estimates(points.size());
+	n_blocks.assign(points.size(), 0);
+	int n_chunks = (_n_threads <= 0) ? thread::hardware_concurrency() : _n_threads;
+	n_chunks = max(1, min(n_chunks, (int)points.size()));
+
+	Frontend base = *this;
+	base._n_threads = 1;		// the threads run over the chunks
+	base._checkpoint_file.clear();
+	parallelFor(n_chunks, n_chunks, [&](int chunk) {
+		Frontend frontend = base;
+		for (int k = chunk * points.size() / n_chunks; k < (chunk + 1) * points.size() / n_chunks; ++k) {
+			vector<pair<int, Angle>> updates;
+			for (int i = 0; i < points[k].size(); ++i) {
+				if (points[k][i] != frontend._gates[i].angle) updates.emplace_back(i, points[k][i]);
+			}
+			frontend.updateAngles(updates);
+
+			if (out_file_name.empty())	frontend.estimate();
+			else						frontend.exportQasm(pointFileName(out_file_name, k), is_binary);
+			estimates[k] = frontend.getEstimate();
+			n_blocks[k] = frontend.getNumBlocks();
+		}
+	});
+	return estimates;
+}
+
+/* ===== Function Description:
+	Remove the distinct blocks no longer used by any segment (e.g., after updating angles), together with their results.
+*/
+void Frontend::removeUnusedBlocks() {
+	int n_blocks = _blocks.size();
+	vector<int> new_ids(n_blocks, -1);
+	for (Segment& segment : _segments) {
+		if (segment.block_id != -1) new_ids[segment.block_id] = 0;
+	}
+
+	int n_used = 0;
+	for (int i = 0; i < n_blocks; ++i) {
+		if (new_ids[i] == -1) {
+			_fingerprints.erase(_block_fingerprints[i]);
+			continue;
+		}
+		new_ids[i] = n_used;
+		if (i != n_used) {
+			_blocks[n_used] = move(_blocks[i]);
+			_block_fingerprints[n_used] = move(_block_fingerprints[i]);
+			_fingerprints[_block_fingerprints[n_used]] = n_used;
+			if (i < _synthesized_levels.size()) {
+				_synthesized_levels[n_used] = _synthesized_levels[i];
+				_block_texts[n_used] = move(_block_texts[i]);
+				_fourier_texts[n_used] = move(_fourier_texts[i]);
+				_fourier_reverted_texts[n_used] = move(_fourier_reverted_texts[i]);
+				_block_costs[n_used] = _block_costs[i];
+				_fourier_costs[n_used] = _fourier_costs[i];
+				_fourier_keys[n_used] = _fourier_keys[i];
+				_block_estimates[n_used] = _block_estimates[i];
+			}
+			else if (n_used < _synthesized_levels.size()) {
+				_synthesized_levels[n_used] = 0;
+			}	// a new block without the results
+			if (i < _block_plans.size())			_block_plans[n_used] = move(_block_plans[i]);
+			else if (n_used < _block_plans.size())	_block_plans[n_used].clear();
+		}
+		n_used++;
+	}
+	if (n_used == n_blocks) return;
+
+	_blocks.resize(n_used);
+	_block_fingerprints.resize(n_used);
+	if (_synthesized_levels.size() > n_used) {
+		_synthesized_levels.resize(n_used);
+		_block_texts.resize(n_used);
+		_fourier_texts.resize(n_used);
+		_fourier_reverted_texts.resize(n_used);
+		_block_costs.resize(n_used);
+		_fourier_costs.resize(n_used);
+		_fourier_keys.resize(n_used);
+		_block_estimates.resize(n_used);
+	}
+	if (_block_plans.size() > n_used) _block_plans.resize(n_used);
+	for (Segment& segment : _segments) {
+		if (segment.block_id != -1) segment.block_id = new_ids[segment.block_id];
+	}
+}
+
+/* ===== Function Description:
+	Get the number of rotation blocks in the circuit.
+*/
+int Frontend::getNumLayers() {
+	int n_layers = 0;
+	for (Segment& segment : _segments) {
+		if (segment.block_id != -1) n_layers++;
+	}
+	return n_layers;
+}
+
+/* ===== Function Description:
+	Rename the data qubits "q[i]" of a synthesized block into "q[qubit_map[i]]".
+*/
+string renameQubits(const string& block, const vector<int>& qubit_map) {
+	string renamed;
+	renamed.reserve(block.size());
+	size_t pos = 0;
+	while (true) {
+		size_t found = block.find("q[", pos);
+		while (found != string::npos && found > 0 && (isalnum(block[found - 1]) || block[found - 1] == '_')) {
+			found = block.find("q[", found + 1);
+		}
+		if (found == string::npos) break;
+
+		size_t close = block.find(']', found);
+		renamed.append(block, pos, found + 2 - pos);
+		renamed += to_string(qubit_map[stoi(block.substr(found + 2, close - found - 2))]);
+		pos = close;
+	}
+	renamed.append(block, pos, string::npos);
+	return renamed;
+}
+
+/* ===== Function Description:
+	Synthesize the distinct blocks concurrently.
+	If 'to_export' is false, only the statistics of the blocks are calculated.
+	Blocks with the results from a previous call are skipped,
+	and blocks with plans (from a previous call or a plan file) are not optimized again.
+	With a checkpoint file, the plan is written periodically and at the end.
+*/
+void Frontend::synthesize(bool to_export) {
+	int n_blocks = _blocks.size();
+	_synthesized_levels.resize(n_blocks, 0);
+	_block_texts.resize(n_blocks);
+	_fourier_texts.resize(n_blocks);
+	_fourier_reverted_texts.resize(n_blocks);
+	_lowered_texts.resize(n_blocks);
+	_block_costs.resize(n_blocks);
+	_fourier_costs.resize(n_blocks);
+	_fourier_keys.resize(n_blocks);
+	_block_estimates.resize(n_blocks);
+	_block_plans.resize(n_blocks);
+
+	char level = to_export ? 2 : 1;
+	vector<int> jobs;		// blocks without the results
+	for (int i = 0; i < n_blocks; ++i) {
+		if (_synthesized_levels[i] < level) jobs.emplace_back(i);
+	}
+
+	// the plans are kept for the next synthesis and the checkpoints
+	mutex plan_mutex;
+	auto last_checkpoint = chrono::steady_clock::now();
+	auto save_plan = [&](int i, const string& plan) {
+		lock_guard<mutex> lock(plan_mutex);
+		_block_plans[i] = plan;
+		if (_checkpoint_file.empty() || chrono::duration<double>(chrono::steady_clock::now() - last_checkpoint).count() < _checkpoint_interval) return;
+		writePlan(_checkpoint_file);
+		last_checkpoint = chrono::steady_clock::now();
+	};
+
+	parallelFor(jobs.size(), _n_threads, [&](int job) {
+		int i = jobs[job];
+		Optimizer op(_config);
+		unique_ptr<Optimizer> booth_op;		// the Booth-encoded table, if the recoded one is tried
+		if (_block_plans[i].empty() || !op.readPlan(_block_plans[i])) {
+			op = Optimizer(_config);
+			for (GateSpec& gate : _blocks[i]) {
+				op.addGate(gate.type, gate.angle, gate.qubits, gatePrecision(gate));
+			}
+			op.initialize();
+			if (_is_recoded) {
+				booth_op.reset(new Optimizer(op));
+				op.recode();
+			}
+		}
+		if (!_checkpoint_file.empty()) op.setCheckpoint([&save_plan, i](const string& plan) { save_plan(i, plan); }, _checkpoint_interval);
+		if (!op.isOptimized()) {
+			auto optimize = [&](Optimizer& o) {
+				if (_exact_nodes > 0)	o.optimizeExact((jobs.size() == 1) ? _n_threads : 1, _exact_nodes);	// the threads run over the blocks if there are several
+				else					o.optimize();
+			};
+			optimize(op);
+			if (booth_op) {
+				optimize(*booth_op);
+				if (booth_op->getOptimizedCost() < op.getOptimizedCost()) op = *booth_op;
+			}
+		}
+		op.concrete();
+		save_plan(i, op.writePlan());
+
+		_block_estimates[i] = op.estimate();
+		_fourier_keys[i] = make_pair(op.getLastAngle(), op.getPrecision());
+		_synthesized_levels[i] = level;
+		if (!to_export) return;
+
+		stringstream block_ss, fourier_ss, fourier_reverted_ss;
+		_block_costs[i] = op.exportQasmBody(block_ss, false);
+		_block_texts[i] = block_ss.str();
+		if (_is_lowered) {	// the Toffoli gates are lowered by a copy, so that '_block_texts' can still be verified
+			Optimizer lowered_op = op;
+			stringstream lowered_ss;
+			lowered_op.setLowered(true);
+			lowered_op.exportQasmBody(lowered_ss, false);
+			_lowered_texts[i] = lowered_ss.str();
+			_block_estimates[i].tmp_width = lowered_op.countScratchAncilla();
+		}
+		if (_config.isSame()) {
+			_fourier_costs[i] = op.exportQasmFourierTrans(fourier_ss, false);
+			op.exportQasmFourierTrans(fourier_reverted_ss, true);
+			_fourier_texts[i] = fourier_ss.str();
+			_fourier_reverted_texts[i] = fourier_reverted_ss.str();
+		}
+	});
+	if (!_checkpoint_file.empty()) writePlan(_checkpoint_file);
+}
+
+/* ===== Function Description:
+	Get the statistics of the stitched circuit without writing any gates.
+*/
+Estimate Frontend::estimate() {
+	synthesize(false);
+	collectEstimate();
+	return _estimate;
+}
+
+/* ===== Function Description:
+	Stitch the statistics of the synthesized blocks into '_estimate'.
+	The blocks are assumed to be applied one by one.
+*/
+void Frontend::collectEstimate() {
+	Estimate est;
+	for (int i = 0; i < _blocks.size(); ++i) {
+		est.n_ancilla = max(est.n_ancilla, _block_estimates[i].n_ancilla);
+		est.add_width = max(est.add_width, _block_estimates[i].add_width);
+		est.frs_width = max(est.frs_width, _block_estimates[i].frs_width);
+		est.cla_width = max(est.cla_width, _block_estimates[i].cla_width);
+		est.lkp_width = max(est.lkp_width, _block_estimates[i].lkp_width);
+		est.hw_width = max(est.hw_width, _block_estimates[i].hw_width);
+		est.tmp_width = max(est.tmp_width, _block_estimates[i].tmp_width);
+		_block_costs[i] = _block_estimates[i].t_count - _block_estimates[i].fourier_cost;
+		_fourier_costs[i] = _block_estimates[i].fourier_cost;
+	}
+
+	int fourier_block = -1;		// the block whose Fourier state is active
+	for (Segment& segment : _segments) {
+		if (segment.block_id == -1) continue;
+
+		int id = segment.block_id;
+		if (_config.isSame() && (fourier_block == -1 || _fourier_keys[fourier_block] != _fourier_keys[id])) {
+			est.t_count += _fourier_costs[id];
+			est.fourier_cost += _fourier_costs[id];
+			est.t_depth += _block_estimates[id].fourier_depth;
+			est.fourier_depth += _block_estimates[id].fourier_depth;
+			fourier_block = id;
+		}
+		est.t_count += _block_costs[id];
+		est.single_cost += _block_estimates[id].single_cost;
+		est.t_depth += _block_estimates[id].t_depth - _block_estimates[id].fourier_depth;
+		est.model_cost += _block_estimates[id].model_cost;
+		est.lower_bound += _block_estimates[id].lower_bound;
+		est.counter_cost += _block_estimates[id].counter_cost;
+		est.hamming_cost += _block_estimates[id].hamming_cost;
+	}
+	_estimate = est;
+}
+
+/* ===== Function Description:
+	Synthesize the distinct blocks and write the stitched circuit in openQASM format,
+	or in the binary circuit format (see 'binary.cpp') if 'is_binary' is true.
+	The "anc", "add", "frs", "cla", "lkp", and "hw" registers are shared by all blocks.
+	For the special case, consecutive blocks with the same angle and precision share one Fourier-state transformation.
+	If the circuit is lowered (see 'setLowered'), the written gates are counted for 'checkLowered'.
+	If the rotations are synthesized (see 'setSynthesized'), their modeled cost in the total is replaced by the T gates of their sequences.
+	Return the total T-count.
+*/
+float Frontend::exportQasm(const string& file_name, bool is_binary) {
+	synthesize(true);
+
+	int n_ancilla = 0;
+	int r = 1;
+	int n_carry_ancilla = 0;
+	int n_lookup_ancilla = 0;
+	int n_hamming_ancilla = 0;
+	int n_scratch_ancilla = 0;
+	for (int i = 0; i < _blocks.size(); ++i) {
+		n_ancilla = max(n_ancilla, _block_estimates[i].n_ancilla);
+		r = max(r, _fourier_keys[i].second);
+		n_carry_ancilla = max(n_carry_ancilla, _block_estimates[i].cla_width);
+		n_lookup_ancilla = max(n_lookup_ancilla, _block_estimates[i].lkp_width);
+		n_hamming_ancilla = max(n_hamming_ancilla, _block_estimates[i].hw_width);
+		n_scratch_ancilla = max(n_scratch_ancilla, _block_estimates[i].tmp_width);
+	}
+
+	ofstream file_ofs(file_name, is_binary ? ios::out | ios::binary : ios::out);
+	unique_ptr<BinaryCircuitWriter> writer(is_binary ? new BinaryCircuitWriter(file_ofs) : nullptr);
+	stringstream text_ss;
+	ostream& ofs = is_binary ? static_cast<ostream&>(text_ss) : file_ofs;
+	auto flush = [&]() {
+		if (!is_binary) return;
+		writer->writeText(text_ss.str());
+		text_ss.str("");
+	};	// the binary format is written segment by segment
+
+	stringstream header_ss;
+	for (string& line : _headers) {
+		header_ss << line << endl;
+	}
+	header_ss << "qreg anc[" << n_ancilla << "];\n";
+	header_ss << "qreg add[" << r + 1 << "];\n";
+	header_ss << "qreg frs[" << r << "];\n";
+	if (n_carry_ancilla > 0) header_ss << "qreg cla[" << n_carry_ancilla << "];\n";
+	if (n_lookup_ancilla > 0) header_ss << "qreg lkp[" << n_lookup_ancilla << "];\n";
+	if (n_hamming_ancilla > 0) header_ss << "qreg hw[" << n_hamming_ancilla << "];\n";
+	if (_is_lowered) {
+		if (n_scratch_ancilla > 0) header_ss << "qreg tmp[" << n_scratch_ancilla << "];\n";
+		header_ss << "creg unc[1];\n";
+	}
+	Optimizer::exportQasmNotice(header_ss, _config.isSame(), _is_lowered);
+	string header = header_ss.str();
+	ofs << header;
+	long long n_lines = count(header.begin(), header.end(), '\n');	// lines written so far, for '_segment_lines'
+	flush();
+
+	// the rotations of the distinct texts are synthesized once, and each text is rewritten once
+	int n_blocks = _blocks.size();
+	vector<string> block_texts, fourier_texts, reverted_texts;
+	vector<long long> block_t_counts(n_blocks, 0), fourier_t_counts(n_blocks, 0), reverted_t_counts(n_blocks, 0);
+	vector<long long> n_rotations(n_blocks, 0), n_reverted_rotations(n_blocks, 0);
+	_n_synthesized = 0;
+	_synthesized_cost = 0;
+	_reverted_synthesized_cost = 0;
+	if (_is_synthesized) {
+		RotationSynthesizer synthesizer(_config.getPrecision());
+		for (int i = 0; i < n_blocks; ++i) {
+			synthesizer.collect(_is_lowered ? _lowered_texts[i] : _block_texts[i]);
+			synthesizer.collect(_fourier_texts[i]);
+			synthesizer.collect(_fourier_reverted_texts[i]);
+		}
+		int n_failed = synthesizer.synthesize(_n_threads);
+		if (n_failed > 0) cerr << "[Warning]: " << n_failed << " rotation angle(s) are written without Clifford+T sequences." << endl;
+		_n_synthesized_angles = synthesizer.getNumAngles() - n_failed;
+		for (int i = 0; i < n_blocks; ++i) {
+			block_texts.push_back(synthesizer.rewrite(_is_lowered ? _lowered_texts[i] : _block_texts[i], block_t_counts[i], n_rotations[i]));
+			fourier_texts.push_back(synthesizer.rewrite(_fourier_texts[i], fourier_t_counts[i], n_rotations[i]));
+			reverted_texts.push_back(synthesizer.rewrite(_fourier_reverted_texts[i], reverted_t_counts[i], n_reverted_rotations[i]));
+		}
+	}
+	const vector<string>& written_texts = _is_synthesized ? block_texts : _is_lowered ? _lowered_texts : _block_texts;
+	const vector<string>& written_fourier_texts = _is_synthesized ? fourier_texts : _fourier_texts;
+	const vector<string>& written_reverted_texts = _is_synthesized ? reverted_texts : _fourier_reverted_texts;
+
+	_lowered_count = CliffordTCounter();
+	auto write = [&](const string& text) {
+		ofs << text;
+		n_lines += count(text.begin(), text.end(), '\n');
+		if (_is_lowered) _lowered_count.count(text);
+	};	// the synthesized gates are counted if lowered
+	float rotation_cost = 0;	// of the single rotation gates and the Fourier-state transformations, which are not lowered
+	float total_cost = 0;
+	int fourier_block = -1;		// the block whose Fourier state is active
+	_segment_lines.assign(_segments.size(), make_pair(0LL, 0LL));
+	for (int k = 0; k < _segments.size(); ++k) {
+		Segment& segment = _segments[k];
+		if (segment.block_id == -1) {
+			ofs << segment.line << "\n";
+			_segment_lines[k] = make_pair(n_lines, n_lines + 1);
+			n_lines++;
+			continue;
+		}
+
+		int id = segment.block_id;
+		if (_config.isSame() && (fourier_block == -1 || _fourier_keys[fourier_block] != _fourier_keys[id])) {
+			if (fourier_block != -1) {
+				write(written_reverted_texts[fourier_block]);
+				_reverted_synthesized_cost += reverted_t_counts[fourier_block];
+				_n_synthesized += n_reverted_rotations[fourier_block];
+			}
+			write(written_fourier_texts[id]);
+			total_cost += _fourier_costs[id];
+			rotation_cost += _fourier_costs[id];
+			_synthesized_cost += fourier_t_counts[id];
+			fourier_block = id;
+		}
+		_segment_lines[k].first = n_lines;
+		write(renameQubits(written_texts[id], segment.qubit_map));
+		_segment_lines[k].second = n_lines;
+		total_cost += _block_costs[id];
+		rotation_cost += _block_estimates[id].single_cost;
+		_synthesized_cost += block_t_counts[id];
+		_n_synthesized += n_rotations[id];
+		flush();
+	}
+	if (fourier_block != -1) {
+		write(written_reverted_texts[fourier_block]);
+		_reverted_synthesized_cost += reverted_t_counts[fourier_block];
+		_n_synthesized += n_reverted_rotations[fourier_block];
+	}
+	flush();
+	_lowered_cost = total_cost - rotation_cost;
+	if (_is_synthesized) {
+		_modeled_rotation_cost = rotation_cost;
+		_lowered_cost += _synthesized_cost + _reverted_synthesized_cost;
+		total_cost += _synthesized_cost - rotation_cost;
+	}
+
+	collectEstimate();
+	return total_cost;
+}
+
+/* ===== Function Description:
+	Verify the circuit written by the last 'exportQasm' into 'file_name' by bit-parallel simulation (see 'Verifier').
+	The file is read back (as the binary circuit format if 'is_binary' is true), its pass-through lines must be the input ones,
+	and each block is checked on its lines of the file against its gates on the qubits of the circuit, concurrently.
+	A lowered or synthesized circuit cannot be simulated, so its distinct blocks are checked before lowering and synthesis instead.
+	Print the result of each failed block, and return true if all blocks pass.
+*/
+bool Frontend::verify(const string& file_name, bool is_binary, int n_samples) {
+	bool is_written = !_is_lowered && !_is_synthesized;
+	vector<string> lines;
+	if (is_written) {
+		string message;
+		if (is_binary) {
+			BinaryFile file(file_name);
+			if (!readBinaryCircuit(file, [&lines](const string& line) { lines.emplace_back(line); }, message)) {
+				cerr << "[Error]: Cannot read back \"" << file_name << "\": " << message << "." << endl;
+				return false;
+			}
+		}
+		else {
+			ifstream ifs(file_name);
+			string line;
+			while (getline(ifs, line)) lines.emplace_back(line);
+		}
+		if (_segment_lines.size() != _segments.size() || (!_segment_lines.empty() && _segment_lines.back().second > lines.size())) {
+			cerr << "[Error]: \"" << file_name << "\" is not the circuit written by this run." << endl;
+			return false;
+		}
+	}
+
+	vector<int> checked;	// segments, or distinct blocks if not written
+	for (int k = 0; k < (is_written ? _segments.size() : _blocks.size()); ++k) {
+		if (is_written && _segments[k].block_id == -1) {
+			if (lines[_segment_lines[k].first] != _segments[k].line) {
+				cerr << "[Error]: Line " << _segment_lines[k].first + 1 << " of the written circuit is not the input line \"" << _segments[k].line << "\"." << endl;
+				return false;
+			}
+			continue;
+		}
+		checked.emplace_back(k);
+	}
+
+	vector<string> messages(checked.size());
+	vector<char> is_passed(checked.size(), false);
+	parallelFor(checked.size(), _n_threads, [&](int i) {
+		if (!is_written) {
+			Verifier verifier(_blocks[checked[i]], _config.getPrecision(), _fourier_keys[checked[i]].second, _config.isSame());
+			is_passed[i] = verifier.verify(_block_texts[checked[i]], n_samples, messages[i]);
+			return;
+		}
+		const Segment& segment = _segments[checked[i]];
+		vector<GateSpec> gates = _blocks[segment.block_id];
+		for (GateSpec& gate : gates) {
+			for (int& qubit : gate.qubits) qubit = segment.qubit_map[qubit];
+		}
+		string text;
+		for (long long line = _segment_lines[checked[i]].first; line < _segment_lines[checked[i]].second; ++line) {
+			text += lines[line] + "\n";
+		}
+		Verifier verifier(gates, _config.getPrecision(), _fourier_keys[segment.block_id].second, _config.isSame());
+		is_passed[i] = verifier.verify(text, n_samples, messages[i]);
+	});
+
+	bool is_all_passed = true;
+	for (int i = 0; i < checked.size(); ++i) {
+		if (is_passed[i]) continue;
+		if (is_written) {
+			cerr << "[Error]: Block " << _segments[checked[i]].block_id << " at lines " << _segment_lines[checked[i]].first + 1 << "-" << _segment_lines[checked[i]].second;
+			cerr << " of the written circuit fails the verification: " << messages[i] << endl;
+		}
+		else {
+			cerr << "[Error]: Block " << checked[i] << " fails the verification: " << messages[i] << endl;
+		}
+		is_all_passed = false;
+	}
+	if (is_all_passed && !checked.empty()) {
+		if (is_written)	cout << "Verified " << checked.size() << " block(s) of the written circuit, e.g., the first one on " << messages[0] << "." << endl;
+		else			cout << "Verified " << checked.size() << " distinct block(s) before " << (_is_lowered ? "lowering" : "synthesis") << ", e.g., block 0 on " << messages[0] << "." << endl;
+	}
+	return is_all_passed;
+}
+
+/* ===== Function Description:
+	Print the gate counts of the last lowered 'exportQasm', and check its T-count against the modeled one,
+	i.e., the T gates must be exactly the modeled T-count of the gates other than the rotations, which are not lowered,
+	plus the T gates of the synthesized rotations if any.
+	Return false with an error if the counts disagree or a gate is not lowered.
+*/
+bool Frontend::checkLowered() {
+	const CliffordTCounter& count = _lowered_count;
+	cout << "Lowered T-count = " << count.t_count << ", T-depth = " << count.t_depth << ", Clifford gates = " << count.n_clifford;
+	cout << ", measurements = " << count.n_measure << ", rotations = " << count.n_rotation << endl;
+	if (!count.other_gates.empty()) {
+		cerr << "[Error]: The lowered circuit has gates other than Clifford+T gates and rotations:";
+		for (const string& gate : count.other_gates) cerr << " " << gate;
+		cerr << "." << endl;
+		return false;
+	}
+	if (fabs(count.t_count - _lowered_cost) > 1e-3 * max(1.0f, _lowered_cost)) {
+		cerr << "[Error]: The lowered T-count " << count.t_count << " differs from the modeled T-count " << _lowered_cost << " of the gates other than the rotations" << (_is_synthesized ? " plus the synthesized ones." : ".") << endl;
+		return false;
+	}
+	return true;
+}
+
+/* ===== Function Description:
+	Print the rotations of the last synthesized 'exportQasm' and their T-count against the modeled one,
+	which does not count the reverted Fourier-state transformations.
+*/
+void Frontend::printSynthesized() {
+	cout << "Rotations in Clifford+T = " << _n_synthesized << " (" << _n_synthesized_angles << " distinct angle(s)), T-count = " << _synthesized_cost;
+	cout << " instead of the modeled " << _modeled_rotation_cost;
+	if (_reverted_synthesized_cost > 0) cout << " (plus " << _reverted_synthesized_cost << " in the reverted Fourier-state transformations)";
+	cout << endl;
+}
+
+/* ===== Function Description:
+	Distribute a total rounding error over the rotation gates without error annotations to reduce the T-count,
+	by setting their tolerated errors.
+	Since an adder reaches the lowest nonempty column, the columns are cleared from the LSB up:
+	a column is cleared if all the gates can be rounded above it within the budget;
+	otherwise, the gates adding the least errors are rounded above it to lower its height, and the allocation stops.
+	Return the total rounding error, which exceeds the budget if the budget is smaller than the error of the full precision.
+*/
+double Frontend::allocateErrorBudget(double budget) {
+	int r = _config.getPrecision();
+	vector<int> gates;		// gates without error annotations
+	vector<int> precisions(_gates.size(), r);
+	double total_error = 0;
+	for (int id = 0; id < _gates.size(); ++id) {
+		if (_gates[id].max_error < 0) gates.emplace_back(id);
+		else precisions[id] = gatePrecision(_gates[id]);
+		total_error += roundingError(_gates[id].angle, precisions[id]);
+	}
+	if (total_error > budget) return total_error;
+
+	for (int column = r - 1; column >= 0; --column) {
+		vector<pair<double, int>> extra_errors;		// (extra error of rounding the gate into 'column' bits, gate id)
+		double column_error = 0;
+		for (int id : gates) {
+			if (precisions[id] <= column) continue;
+			double extra_error = roundingError(_gates[id].angle, column) - roundingError(_gates[id].angle, precisions[id]);
+			extra_errors.emplace_back(extra_error, id);
+			column_error += extra_error;
+		}
+		if (total_error + column_error <= budget) {
+			for (auto& item : extra_errors) {
+				precisions[item.second] = column;
+			}
+			total_error += column_error;
+			continue;
+		}
+
+		sort(extra_errors.begin(), extra_errors.end());
+		for (auto& item : extra_errors) {
+			if (total_error + item.first > budget) break;
+			precisions[item.second] = column;
+			total_error += item.first;
+		}
+		break;
+	}
+
+	for (int id : gates) {
+		_gates[id].max_error = roundingError(_gates[id].angle, precisions[id]);
+	}
+	for (Segment& segment : _segments) {
+		if (segment.block_id != -1) assignBlock(segment);
+	}
+	removeUnusedBlocks();
+	return total_error;
+}
+
+/* ===== Function Description:
+	Get the total rounding error of the rotation gates (see 'roundingError'), which bounds the error of the synthesized circuit.
+*/
+double Frontend::totalRoundingError() {
+	double total_error = 0;
+	for (GateSpec& gate : _gates) {
+		total_error += roundingError(gate.angle, gatePrecision(gate));
+	}
+	return total_error;
+}
@@ -1,17 +1,30 @@
 #include <iostream>
 #include <set>
+#include <map>
+#include <array>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include <algorithm>
 #include <cassert>
 #include <fstream>
+#include <iomanip>
 #include <string> 
 #include <ctime>
+#include <chrono>
 #include <sstream>
 #include <cmath>
 #include <climits> // for INT_MAX
+#include <limits>
 #include <cfenv> // for fmod
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <random>
+#include <memory>
+#include <cstring>
 
 // for M_PI
 #define _USE_MATH_DEFINES	
@@ -19,7 +32,7 @@
 
 using namespace std;
 
-extern float COST_TOFFOLI;
+const float COST_INF = numeric_limits<float>::infinity();	// cost of an infeasible method
 
 template <typename T>
 void print(T t) {
@@ -43,10 +56,51 @@ enum GATETYPE {
 	RX, RY, RZ, RXX, RYY, RZZ, P, CP
 };
 
+enum ADDERTYPE {
+	RIPPLE,		// ripple-carry adder [S. A. Cuccaro et al., 2004]
+	PREFIX		// carry-lookahead adder [T. G. Draper et al., 2004]
+};
+
+enum PHASINGTYPE {	// engine of the adder rows
+	AUTO,		// the cheaper one
+	COUNTER,	// counters and adders of the optimizer
+	HAMMING		// Hamming-weight phasing [C. Gidney, 2018] in the special case, or a carry-save compressor otherwise
+};
+
+enum BINARYKIND {
+	ROTATIONS = 1,	// rotation layer with fixed-size records
+	CIRCUIT = 2,	// streamed circuit
+	ANGLES = 3,		// matrix of angle vectors for the sweep mode
+	PLAN = 4		// synthesis plan of a circuit
+};
+
+enum BINARYOP {
+	OP_QREG = 1,	// register declaration
+	OP_TEXT = 2,	// a line kept as text
+	OP_MCX = 3,		// multi-controlled NOT with a varint number of wires
+	OP_FIXED = 16,	// gates with a fixed number of wires (see 'binary.cpp')
+	OP_ANGLE = 32	// gates with an angle and a wire
+};
+
+class Angle {		// a rotation angle, kept exactly if it is a dyadic multiple of pi
+public:
+	Angle(double radians = 0) : radians(radians) {}
+	double radians;
+	bool is_exact = false;
+	long long numerator = 0;	// if exact, the angle is numerator / 2^log_denominator turns (of 2 * pi)
+	int log_denominator = 0;
+	bool operator==(const Angle& other) const {
+		if (is_exact != other.is_exact) return false;
+		return is_exact ? (numerator == other.numerator && log_denominator == other.log_denominator) : (radians == other.radians);
+	}
+	bool operator!=(const Angle& other) const { return !(*this == other); }
+};
+
 class Gate {
 public:
-	Gate(int id, GATETYPE type, const vector<int>& qubits) : _id(id), _type(type), _qubits(qubits) {};
+	Gate(int id, GATETYPE type, const vector<int>& qubits, int precision = INT_MAX) : _id(id), _type(type), _qubits(qubits), _precision(precision) {};
 	int getId() { return _id; }
+	GATETYPE getType() const { return (GATETYPE)_type; }
 	string getTypeStr() {
 		switch (_type) {
 			case GATETYPE::RX:
@@ -70,12 +124,15 @@ public:
 		}
 	}
 	int getQubit(int index) const { return _qubits[index]; }
+	int getNumQubits() const { return _qubits.size(); }
+	int getPrecision() const { return _precision; }		// number of bits of the angle (INT_MAX: the precision of the optimizer)
 	void setName(const string& name) { _name = name; }
 	const string& getName() const { return _name; }
 private:
 	int _id;
 	int _type;
 	vector<int> _qubits;
+	int _precision;
 	float _value = 0;  // only for single-gate
 	string _name;
 	//bool _activate = true;
@@ -102,7 +159,7 @@ public:
 		if (_type == BITTYPE::NEG) return '-';
 		return 'c';
 	}
-	int getGateId() { return _gate->getId(); }
+	int getGateId() const { return _gate->getId(); }
 	const string& getName() const { return _gate->getName(); }
 	bool isActivate() { return _is_activate; }// _gate->isActivate();
 	void setInactivate() { _is_activate = false; }
@@ -120,27 +177,157 @@ private:
 	int _power = 0;					// for counter bits
 };
 
+class NetGate {		// a gate of a reversible network on numbered wires
+public:
+	NetGate(const vector<int>& wires, bool is_uncompute = false) : wires(wires), is_uncompute(is_uncompute) {}
+	vector<int> wires;			// controls followed by the target; a single wire is a NOT gate
+	bool is_uncompute;			// a Toffoli gate clearing its target, which costs no T gate [C. Gidney, 2018]
+};
+
+class Config {		// immutable settings of an optimizer, so that optimizers with different settings can run concurrently
+public:
+	Config(int precision = 30, float cost_single = INT_MAX, bool is_same = false, ADDERTYPE adder_type = ADDERTYPE::RIPPLE, float cost_toffoli = 4, float depth_toffoli = 2, int lookup_width = 0, PHASINGTYPE phasing_type = PHASINGTYPE::AUTO)
+		: _precision(precision), _cost_single(cost_single), _is_same(is_same), _adder_type(adder_type), _cost_toffoli(cost_toffoli), _depth_toffoli(depth_toffoli), _lookup_width(lookup_width), _phasing_type(phasing_type) {}
+	int getPrecision() const { return _precision; }			// number of bits
+	float getCostSingle() const { return getCostSingle(_precision); }	// T-count of applying an independent single-gate rotation
+	float getCostSingle(int precision) const;				// the same with 'precision' bits, from 'countSingleCost' if the cost is negative (defined in 'external.cpp')
+	bool isCostModel() const { return _cost_single < 0; }
+	bool isSame() const { return _is_same; }				// special mode for synthesizing the same angles
+	ADDERTYPE getAdderType() const { return _adder_type; }
+	float getCostToffoli() const { return _cost_toffoli; }	// T-count of a Toffoli gate
+	float getDepthToffoli() const { return _depth_toffoli; }	// T-depth of a Toffoli gate (2 by the temporary logical-AND [C. Gidney, 2018])
+	int getLookupWidth() const { return _lookup_width; }		// maximum number of gates added by a table lookup (0: no table lookups)
+	PHASINGTYPE getPhasingType() const { return _phasing_type; }	// engine of the special case
+private:
+	int _precision;
+	float _cost_single;
+	bool _is_same;
+	ADDERTYPE _adder_type;
+	float _cost_toffoli;
+	float _depth_toffoli;
+	int _lookup_width;
+	PHASINGTYPE _phasing_type;
+};
+
+class Estimate {	// statistics of a synthesized circuit
+public:
+	float t_count = 0;
+	float t_depth = 0;
+	float fourier_cost = 0;		// part of 't_count' for the Fourier-state transformation
+	float fourier_depth = 0;	// part of 't_depth' for the Fourier-state transformation
+	float single_cost = 0;		// part of 't_count' for the single rotation gates
+	int n_ancilla = 0;			// size of the "anc" register
+	int add_width = 0;			// size of the "add" register
+	int frs_width = 0;			// size of the "frs" register
+	int cla_width = 0;			// size of the "cla" register (carry-lookahead adders only)
+	int lkp_width = 0;			// size of the "lkp" register (table lookups only)
+	int hw_width = 0;			// size of the "hw" register (Hamming-weight phasing only)
+	int tmp_width = 0;			// size of the "tmp" register (lowered circuits only, known after exporting)
+	float model_cost = 0;		// cost estimated by the optimizer
+	float lower_bound = 0;		// lower bound on the optimal 'model_cost'
+	float counter_cost = 0;		// 'model_cost' of the adder rows (the counters in the special case) (0 if not compared)
+	float hamming_cost = 0;		// 'model_cost' of Hamming-weight phasing in the special case, or of the carry-save compressor otherwise (0 if not compared)
+};
+
+class CostModel {	// precomputed cost tables for the optimizer
+public:
+	// defined in 'external.cpp'
+	CostModel(const Config& config = Config(1), int max_counter_size = 2);
+	float adderCost(int min_bit) const;
+	float adderDepth(int min_bit) const;
+	float counterCost(int counter_size, int dis_to_head) const;
+	float counterMarginalCost(int counter_size, int dis_to_head) const;	// counterCost(counter_size) - counterCost(counter_size - 1)
+	float lookupCost(int width) const;		// of the lookup and the unlookup of a table, without the adder
+	float lookupDepth(int width) const;
+	float getCostToffoli() const { return _cost_toffoli; }
+private:
+	float _cost_toffoli;
+	float _depth_toffoli;
+	ADDERTYPE _adder_type;
+	int _max_counter_size;
+	int _max_level;							// floor(log2(_max_counter_size))
+	vector<float> _adder_costs;				// [min_bit]
+	vector<float> _adder_depths;			// [min_bit]
+	vector<vector<float>> _counter_costs;	// [counter_size][min(dis_to_head, _max_level)]
+	vector<vector<float>> _marginal_costs;	// [counter_size][min(dis_to_head, _max_level)]
+};
+
+class WorkStealingPool {	// tasks that spawn more tasks, balanced by stealing the oldest tasks of other threads
+public:
+	// defined in 'external.cpp'
+	WorkStealingPool(int n_threads);
+	void push(int worker, const function<void(int)>& task);	// a task is called with the index of the running thread
+	void run();												// run until all tasks (including the spawned ones) are done
+	bool isHungry() { return _n_idle > 0; }					// some thread is waiting for tasks
+private:
+	int _n_threads;
+	vector<deque<function<void(int)>>> _queues;
+	vector<mutex> _mutexes;
+	atomic<long long> _n_pending{ 0 };
+	atomic<int> _n_idle{ 0 };
+
+	bool pop(int worker, function<void(int)>& task);
+};
+
+class Lookup {		// a table lookup adding the sum of the angles of the gates whose representative qubits are 1 by one adder
+public:
+	vector<int> gate_ids;			// the address bits, from the most significant one
+	vector<vector<int>> digits;		// digits[k][i]: signed digit of the k-th gate at the i-th column
+};
+
+class Product {		// a product of gate bits for the counters, stored on an "anc" qubit if it has several factors
+public:
+	vector<pair<int, bool>> literals;	// factors as (-1 - qubit of single-qubit gates or gate id of the others, is NEG), sorted
+	int halves[2] = { -1, -1 };			// products whose logical AND is this one; -1 for a single factor
+	string name;						// the stored product, or the representative qubit of the single factor
+};
+
 class Optimizer {
 public:
 	// defined in 'optimize.cpp'
-	Optimizer(int precision, float cost_single = INT_MAX, bool is_same = false); // : _r(precision), _is_same(is_same), _cost_single(cost_single) {}
+	Optimizer(const Config& config);
 	pair<float, int> optimize(bool to_print_info = false);
+	pair<float, int> optimizeExact(int n_threads = 0, long long max_nodes = 100000);
+	float lowerBound();
+	float getOptimizedCost() { return _optimized_cost; }	// cost of the last 'optimize' or 'optimizeExact'
+	float getLowerBound() { return _lower_bound; }			// lower bound on the optimal cost found by the last 'optimize' or 'optimizeExact'
+	bool isOptimized() { return _is_optimized; }
 	void concrete();
+	void setCheckpoint(const function<void(const string&)>& save_plan, double interval);	// called with 'writePlan' every 'interval' seconds while optimizing
 	
 	// defined in 'io.cpp'
 	void importQasm(const string& file_name);
+	void addGate(GATETYPE gate_type, const Angle& angle, const vector<int>& qubits, int precision = INT_MAX);
+	void initialize();
+	void recode();
 	
 	float exportQasm(const string& file_name);
+	float exportQasmBody(ostream& ofs, bool with_fourier = true);
+	float exportQasmFourierTrans(ostream& ofs, bool is_reverted);
+	static void exportQasmNotice(ostream& ofs, bool is_same, bool is_lowered = false);
+	void setLowered(bool is_lowered) { _is_lowered = is_lowered; }	// write the Toffoli gates in Clifford+T (see 'exportQasmAnd')
+	int countScratchAncilla() { return _n_scratch; }	// size of the "tmp" register used by the last lowered export
+	int countAncilla();
+	int countCarryAncilla();
+	int countLookupAncilla();
+	int countHammingAncilla();
+	Estimate estimate();
+	int getPrecision() { return _r; }
+	const Config& getConfig() { return _config; }
+	double getLastAngle() { return _last_angle; }
 	float importBitList(const string& file_name);
 	void printInfo(const string& header = "");
+
+	// defined in 'binary.cpp'
+	string writePlan();
+	bool readPlan(const string& plan);
 private:
+	Config _config;
 	int _n;				// number of gates = _gate_list.size()
-	int _r;				// number of bits (precision)
-	bool _is_same;		// special mode for synthesize same angles
+	int _r;				// number of bits (= _config.getPrecision())
 	double _last_angle;
 	vector<Gate*> _gate_list;
 	vector<vector<Bit>> _bit_table;		// _r * _n
-	float _cost_single;
 	set<int> _involved_qubits_x;
 	set<int> _involved_qubits_y;
 	set<int> _involved_qubits_z;
@@ -152,9 +339,36 @@ private:
 	vector<int> _n_counter;					// _n_counter[i] = sum(_counter_sizes[i])
 	vector<vector<int>> _counter_sizes;		// each in the decreasing order
 	vector<pair<Gate*, int>> single_gates;
-	unordered_map<int, float> _excluded;
+	vector<Lookup> _lookups;
+	bool _is_lookup_trial = false;			// a copy optimized by 'planLookups', which plans no lookups itself
+	bool _is_hamming = false;				// the special case by Hamming-weight phasing, where the bit table is one counter of all gates, or the carry-save compressor otherwise
+	float _counter_cost = 0;				// costs of the engines compared by 'optimize' (the adder rows and 'useHamming')
+	float _hamming_cost = 0;
+	map<int, double> _excluded;				// gate id -> angle of the excluded single rotation, which are exported in the order of the ids
 	vector<string> _headers;
 	float _cost = 0;
+	float _optimized_cost = 0;
+	float _lower_bound = 0;
+	bool _is_concrete = false;
+	bool _is_optimized = false;				// by 'optimize' or 'optimizeExact' (or loaded from a final plan)
+	bool _is_resumed = false;				// loaded from a checkpoint, where '_optimized_cost' is the cost paid so far
+	CostModel _cost_model;
+	int _max_counter_size = 0;				// of '_cost_model'
+	function<void(const string&)> _save_plan;
+	double _checkpoint_interval = 0;
+	chrono::steady_clock::time_point _last_checkpoint;
+	int _n_rows = 0;						// number of adder rows, which are followed by a row for each table lookup and one for the single rotations
+	int _n_ancilla = 0;						// peak number of live representative ancillas
+	vector<vector<int>> _anc_computed;		// row -> gates whose representative ancillas are computed before the row
+	vector<vector<int>> _anc_uncomputed;	// row -> gates whose representative ancillas are uncomputed after the row
+	vector<Product> _products;				// products of the counters (see 'planProducts')
+	vector<vector<int>> _products_computed;		// row -> stored products computed before the row, after their halves
+	vector<vector<int>> _products_uncomputed;	// row -> stored products uncomputed after the row, before their halves
+	vector<vector<vector<int>>> _counter_terms;	// [column][row] -> products whose parity is the counter bit
+	bool _is_lowered = false;
+	set<int> _free_scratch;					// free indices of the "tmp" register, which holds the logical-AND gates of lowered Toffoli gates
+	int _n_scratch = 0;						// peak number of live "tmp" qubits
+
 	
 	// defined in 'optimize.cpp'
 	void updatePeaks(vector<int>& peaks);
@@ -163,27 +377,336 @@ private:
 	int findSplittedGate(int index, unordered_set<int>& pos_gates, unordered_set<int>& neg_gates, int index_bound);
 	void splitGate(int index, int gate_id);
 
-	int doCounter(vector<int>& new_height, vector<int>& new_n_carry, vector<int>& new_n_counter, vector<vector<int>>& new_counter_sizes, const vector<int>& peaks, int& dealing_peak_index);
-	int mergeCounter(vector<int>& new_height, vector<int>& new_n_carry, vector<int>& new_n_counter, vector<vector<int>>& new_counter_sizes, const vector<int>& peaks, int& dealing_peak_index);
+	float doCounter(vector<int>& new_height, vector<int>& new_n_carry, vector<int>& new_n_counter, vector<vector<int>>& new_counter_sizes, const vector<int>& peaks, int& dealing_peak_index);
+	float mergeCounter(vector<int>& new_height, vector<int>& new_n_carry, vector<int>& new_n_counter, vector<vector<int>>& new_counter_sizes, const vector<int>& peaks, int& dealing_peak_index);
 	int findTargetCounterMin(const vector<int>& counter_sizes);
 	
-	int doSingle(unordered_set<int>& new_excluded, vector<int> peaks_remaining);
+	float doSingle(unordered_set<int>& new_excluded, vector<int> peaks_remaining);
 	void removeExcluded();
+	void shrinkCounters();
+	float excludeGates(const unordered_set<int>& gates);
+	float removeGates(const unordered_set<int>& gates, const function<void(const Bit&, int)>& take_bit);
+	vector<int> lookupCandidates(const vector<int>& peaks);
+	float lookupCost(const Lookup& lookup);
+	float doLookup(vector<int>& new_lookup, const vector<int>& peaks_remaining, int& n_levels);
+	float planLookups();
+	void hammingLevels(vector<vector<int>>& levels);
+	int buildHamming(vector<NetGate>& gates, vector<int>& weights, int& last_bit);
+	float hammingCost();
+	vector<vector<Bit>> compressorTable();
+	void useHamming(const vector<vector<Bit>>& compressed_table = {});
+	float lookupGates(const vector<int>& gates);
+
+	float startCost();
+	float singleCost(int gate_id) { return _config.getCostSingle(_gate_list[gate_id]->getPrecision()); }	// of the single rotation of a gate
+	float excludeCost(int gate_id) { return _excluded.count(gate_id) ? 0 : singleCost(gate_id); }	// of excluding a gate, whose single rotation is paid once
+	void checkpoint(float total_cost);
+	float fixedCost();
+	float placedCounterCost();
+	float closeCost(int& n_adder);
+	float remainingBound(int excluded_gate = -1);
+	vector<int> splitCandidates(int index);
 
 	void splitGateAny(int index);
 
 	// defined in 'io.cpp'
-	void exportQasmFourierTrans(ofstream& ofs, bool is_reverted);
-	void exportQasmRotTypeTrans(ofstream& ofs, bool is_reverted);
-	void exportQasmSetAnc(ofstream& ofs, bool is_reverted);
-	void exportQasmWriteAdder(ofstream& ofs);
-	int exportQasmSetAdderBits(ofstream& ofs, int ith_adder, bool is_reverted);
-	void exportCounter(ofstream& ofs, const vector<Bit>& carry_ins, vector<int>& selected, int k, string& target_name, bool is_reverted);
-	void exportQasmWriteSingle(ofstream& ofs);
+	void exportQasmRotTypeTrans(ostream& ofs, bool is_reverted);
+	void allocateAncilla();
+	void exportQasmSetAnc(ostream& ofs, int row, bool is_reverted);
+	void exportQasmWriteAdder(ostream& ofs, int ith_adder);
+	void exportQasmWriteRippleAdder(ostream& ofs, int last_bit);
+	void exportQasmWritePrefixAdder(ostream& ofs, int last_bit);
+	vector<vector<int>> lookupTable(const Lookup& lookup, int& last_bit);
+	void exportQasmWriteLookup(ostream& ofs, int ith_lookup);
+	void exportQasmWriteHamming(ostream& ofs);
+	void exportQasmIterateLookup(ostream& ofs, const Lookup& lookup, const vector<vector<int>>& table, int depth, const string& flag, int entry);
+	int exportQasmSetAdderBits(ostream& ofs, int ith_adder);
+	void planProducts();
+	void exportQasmSetProducts(ostream& ofs, int row, bool is_reverted);
+	void exportQasmWriteSingle(ostream& ofs);
+	void exportQasmAnd(ostream& ofs, const string& a, const string& b, const string& target);
+	void exportQasmUnand(ostream& ofs, const string& a, const string& b, const string& target);
+	void exportQasmToffoli(ostream& ofs, const vector<string>& controls, const string& target);
+	void exportQasmNetGate(ostream& ofs, const NetGate& gate, const vector<string>& names, bool is_uncompute, vector<char>& is_zero);
+	string allocateScratch();
+	void freeScratch(const string& name);
 };
 
+class GateSpec {	// a parsed rotation gate
+public:
+	GATETYPE type;
+	Angle angle;
+	vector<int> qubits;
+	double max_error = -1;		// tolerated rounding error (see 'roundingError'), which lowers the precision of the gate; negative for none
+};
+
+class Segment {		// a part of the output circuit
+public:
+	int block_id = -1;			// index of the synthesized block; -1 for a pass-through line
+	vector<int> qubit_map;		// canonical qubit index -> qubit index in the circuit
+	vector<int> gate_ids;		// rotation gates of the block (indices in the input order)
+	string line;				// pass-through line
+};
+
+class Layer {		// a block being parsed, followed by the pass-through lines after it
+public:
+	vector<int> gate_ids;
+	unordered_map<int, int> axis;				// qubit -> rotation axis of the gates on it
+	vector<string> pending;						// pass-through lines after the block in the circuit
+	unordered_map<int, char> pending_type;		// qubit -> Pauli type of 'pending' on it ('x', 'y', 'z', or 'n' for non-commuting)
+};
+
+class Verifier {	// bit-parallel simulation of the reversible part of a synthesized block
+public:
+	// defined in 'verify.cpp'
+	Verifier(const vector<GateSpec>& gates, int precision, int frs_width, bool is_same = false);
+	bool verify(const string& circuit, int n_samples, string& message);
+private:
+	vector<GateSpec> _gates;
+	int _r;								// size of the "frs" register
+	bool _is_same;
+	unsigned long long _mask;			// 2^_r - 1
+	vector<long double> _turns;			// exact angle of each gate in turns
+	vector<long double> _tolerances;	// tolerated phase error of each gate in turns
+	unordered_map<string, int> _wire_ids;
+	vector<string> _wire_names;
+	vector<int> _op_wires;				// wires of all operations, each with the target last
+	vector<int> _op_begins;				// the wires of the i-th operation are _op_wires[_op_begins[i], _op_begins[i + 1])
+	vector<double> _op_phases;			// phase of each "rz" operation in turns; NAN for the others
+	vector<tuple<int, char, int>> _basis_changes;	// (wire, 'h', 's', or 'd' for "sdg", number of operations before it)
+
+	int getWire(const string& name);
+	bool parse(const string& circuit, string& message);
+	bool checkBasis(const vector<int>& data_wires, const vector<int>& axes, string& message);
+	void simulate(vector<unsigned long long>& state, vector<long double>& phases);
+};
+
+class CliffordTCounter {	// gate counts of a circuit lowered into Clifford+T gates, measurements, and rotations
+public:
+	// defined in 'verify.cpp'
+	void count(const string& circuit);
+	long long t_count = 0;
+	int t_depth = 0;
+	long long n_clifford = 0;			// including the ones controlled by measurement results
+	long long n_measure = 0;
+	long long n_rotation = 0;			// single-qubit rotations, which are not lowered
+	set<string> other_gates;			// names of the other gates found
+private:
+	unordered_map<string, int> _t_depths;	// qubit name -> T-depth up to its last gate
+};
+
+class Scheduler {	// ASAP layers of a circuit, where gates acting on a shared qubit by the same Pauli type may be reordered
+public:
+	// defined in 'verify.cpp'
+	void schedule(const string& circuit);
+	string layeredCircuit();
+	int depth = 0;
+	int n_t_layers = 0;				// number of layers with T gates, which is not the T-depth (see 'CliffordTCounter')
+	vector<int> widths;				// number of gates in each layer
+	vector<int> t_widths;			// number of T gates in each layer
+private:
+	class Run {		// consecutive gates on a wire acting on it by the same Pauli type, which commute with each other
+	public:
+		char type = 'n';	// 'n' if the gates do not commute
+		int begin = 0;		// the last layer of the gates before the run
+		int end = 0;		// the last layer of the gates in the run
+	};
+	vector<string> _header;			// declarations and custom gate definitions
+	vector<string> _registers;		// names of the quantum registers
+	vector<vector<string>> _layers;
+};
+
+#ifdef __SIZEOF_FLOAT128__
+const int MAX_SYNTHESIS_PRECISION = 36;		// the lattices of the rotation synthesis need about three times as many bits in quadruple precision
+#else
+const int MAX_SYNTHESIS_PRECISION = 16;		// in long double
+#endif
+
+class RotationSynthesizer {	// Clifford+T sequences replacing the "rz" and "p" rotations of written circuits, memoized by the quantized angle
+public:
+	// defined in 'synth.cpp'
+	RotationSynthesizer(int precision) : _precision(precision) {}
+	void collect(const string& circuit);
+	int synthesize(int n_threads);
+	string rewrite(const string& circuit, long long& t_count, long long& n_rotations) const;
+	int getNumAngles() const { return _sequences.size(); }
+private:
+	class Sequence {	// H, S, T, and Pauli gates (in time order) within the distance 2^-(precision + 1) of a rotation up to a global phase
+	public:
+		vector<string> gates;
+		int t_count = 0;
+		bool is_done = false;		// synthesized, or attempted
+		bool is_found = false;
+	};
+	int _precision;
+	map<long long, Sequence> _sequences;	// quantized angle (in units of 2 * pi / 2^(_precision + 8)) -> sequence
+	long long quantize(double angle) const;
+};
+
+class BinaryFile {	// a read-only view of a binary file, memory-mapped if possible
+public:
+	// defined in 'binary.cpp'
+	BinaryFile(const string& file_name);
+	~BinaryFile();
+	BinaryFile(const BinaryFile&) = delete;
+	BinaryFile& operator=(const BinaryFile&) = delete;
+	int getKind() const;
+	unsigned int getNumQubits() const;
+	unsigned int getNumRecords() const;
+	const unsigned char* getData() const { return _data; }
+	size_t getSize() const { return _size; }
+private:
+	const unsigned char* _data = nullptr;
+	size_t _size = 0;
+	bool _is_mapped = false;
+	string _buffer;		// file content if it is not mapped
+};
+
+class BinaryCircuitWriter {	// streaming writer of the binary circuit format
+public:
+	// defined in 'binary.cpp'
+	BinaryCircuitWriter(ostream& ofs);
+	void writeLine(const string& line);
+	void writeText(const string& text);
+private:
+	ostream& _ofs;
+	unordered_map<string, pair<int, int>> _registers;	// name -> (first wire, size)
+	int _n_wires = 0;
+
+	bool encodeLine(const string& line, string& buffer);
+};
+
+class Frontend {
+public:
+	// defined in 'frontend.cpp'
+	Frontend(const Config& config, int n_threads = 0) : _config(config), _n_threads(n_threads) {}
+	void importQasm(const string& file_name);
+	void importBinary(const string& file_name);
+	float exportQasm(const string& file_name, bool is_binary = false);
+	Estimate estimate();
+	const Estimate& getEstimate() { return _estimate; }	// statistics of the last estimated or exported circuit
+	bool isPlanImported() { return _is_plan_imported; }	// the optimizer costs of a plan are the ones of the run that wrote it, e.g., with another adder
+	bool verify(const string& file_name, bool is_binary, int n_samples);
+	double allocateErrorBudget(double budget);
+	double totalRoundingError();
+	int updateAngles(const vector<pair<int, Angle>>& updates);
+	vector<Estimate> sweep(const vector<vector<Angle>>& points, const string& out_file_name, bool is_binary, vector<int>& n_blocks);
+	int getNumLayers();
+	int getNumBlocks() { return _blocks.size(); }
+	int getNumGates() { return _gates.size(); }
+	void setExact(long long max_nodes) { _exact_nodes = max_nodes; }	// use 'Optimizer::optimizeExact' with the node budget (0: the greedy 'optimize')
+	void setMaxLayers(int max_layers) { _max_layers = max(1, max_layers); }	// number of blocks being parsed at once (see 'addRotation')
+	void setCheckpoint(const string& file_name, double interval) { _checkpoint_file = file_name; _checkpoint_interval = interval; }	// write the plan every 'interval' seconds while synthesizing
+	void setLowered(bool is_lowered) { _is_lowered = is_lowered; }	// let 'exportQasm' write the Toffoli gates in Clifford+T
+	void setRecoded(bool is_recoded) { _is_recoded = is_recoded; }	// also optimize each block from 'Optimizer::recode' and keep the cheaper result
+	void setSynthesized(bool is_synthesized) { _is_synthesized = is_synthesized; }	// let 'exportQasm' write the rotations in Clifford+T (see 'RotationSynthesizer')
+	bool checkLowered();
+	void printSynthesized();
+
+	// defined in 'binary.cpp'
+	void writePlan(const string& file_name);
+	bool importPlan(const string& file_name, string& message);
+private:
+	Config _config;
+	int _n_threads;								// 0: use all hardware threads
+	long long _exact_nodes = 0;
+	string _checkpoint_file;
+	double _checkpoint_interval = 0;
+	bool _is_lowered = false;
+	bool _is_synthesized = false;
+	bool _is_recoded = false;
+	bool _is_plan_imported = false;
+	vector<string> _headers;
+	vector<Segment> _segments;
+	vector<pair<long long, long long>> _segment_lines;	// lines [first, second) of each segment in the last 'exportQasm'
+	vector<GateSpec> _gates;					// rotation gates in input order (indexed by gate id)
+	vector<int> _gate_segments;					// gate id -> index in '_segments'
+	vector<vector<GateSpec>> _blocks;			// distinct blocks with canonical qubit indices
+	vector<string> _block_fingerprints;
+	unordered_map<string, int> _fingerprints;	// fingerprint -> index in '_blocks'
+	deque<Layer> _layers = deque<Layer>(1);		// blocks being parsed in the circuit order, where the last one receives the pass-through lines
+	int _max_layers = 1;
+	bool _in_gate_definition = false;
+	bool _has_qreg = false;						// the quantum register "q" is declared (see 'importLine')
+
+	// results of the distinct blocks
+	vector<char> _synthesized_levels;			// 0: not synthesized, 1: estimated, 2: exported
+	vector<string> _block_texts;
+	vector<string> _fourier_texts;
+	vector<string> _fourier_reverted_texts;
+	vector<string> _lowered_texts;				// '_block_texts' in Clifford+T if '_is_lowered'
+	vector<float> _block_costs;					// excluding the Fourier-state transformation
+	vector<float> _fourier_costs;
+	vector<pair<double, int>> _fourier_keys;	// (angle, precision) of the Fourier state
+	vector<Estimate> _block_estimates;
+	vector<string> _block_plans;				// 'Optimizer::writePlan' of each block (empty if not synthesized)
+	Estimate _estimate;
+	CliffordTCounter _lowered_count;			// of the last lowered 'exportQasm'
+	float _lowered_cost = 0;					// the modeled T-count of its gates other than the rotations (plus the synthesized ones)
+	long long _n_synthesized = 0;				// rotations of the last synthesized 'exportQasm'
+	int _n_synthesized_angles = 0;
+	long long _synthesized_cost = 0;			// their T-count, excluding the reverted Fourier-state transformations
+	long long _reverted_synthesized_cost = 0;
+	float _modeled_rotation_cost = 0;
+
+	void importLine(const string& qasm_line);
+	void addRotation(const GateSpec& gate);
+	bool canJoinLayer(const Layer& layer, const GateSpec& gate);
+	void addPassThrough(const string& line);
+	void flushLayer();
+	void closeLayer();
+	int gatePrecision(const GateSpec& gate);
+	bool assignBlock(Segment& segment);
+	void removeUnusedBlocks();
+	void synthesize(bool to_export);
+	void collectEstimate();
+};
+
+// defined in 'io.cpp'
+int getAxis(GATETYPE gate_type);
+double angleToBits(double angle, int r, vector<int>& bit_string);
+double angleToBits(const Angle& angle, int r, vector<int>& bit_string);
+long double angleToTurns(const Angle& angle);
+double roundingError(const Angle& angle, int precision);
+int precisionForError(const Angle& angle, double max_error, int max_precision);
+bool parseAngle(const string& expression, Angle& angle);
+bool parseRotation(const string& qasm_line, GATETYPE& gate_type, Angle& angle, vector<int>& qubits);
+bool readAngleMatrix(const string& file_name, vector<vector<Angle>>& points, string& message);
+
+// defined in 'binary.cpp'
+unsigned long long angleToWord(const Angle& angle);
+Angle wordToAngle(unsigned long long word);
+string angleToQasm(const Angle& angle);
+bool isBinaryFile(const string& file_name);
+void writeBinaryRotations(ostream& ofs, int n_qubits, const vector<GateSpec>& gates);
+int readBinaryRotations(const BinaryFile& file, vector<GateSpec>& gates);
+bool readBinaryCircuit(const BinaryFile& file, const function<void(const string&)>& handle_line, string& message);
+bool convertCircuit(const string& in_file_name, const string& out_file_name, string& message);
+void writeBinaryAngleMatrix(ostream& ofs, const vector<vector<Angle>>& points);
+bool readBinaryAngleMatrix(const BinaryFile& file, vector<vector<Angle>>& points);
+
+// defined in 'verify.cpp'
+bool parseGateLine(string line, string& gate_name, vector<string>& operands, string& condition, string& target);
+bool scheduleCircuit(const string& file_name, const string& csv_file_name, bool is_layered, Scheduler& scheduler, string& message);
+
+// defined in 'frontend.cpp'
+string renameQubits(const string& block, const vector<int>& qubit_map);
+string pointFileName(const string& file_name, int point);
+char getPauliType(const string& gate_name, int operand_index);
+
+// defined in 'external.cpp'
+void parallelFor(int n_jobs, int n_threads, const function<void(int)>& job);
+
 // defined in 'external.cpp'
-int nCr(int n, int k);
-int countAdderCost(int min_bit);
-int countCounterCost(int counter_size, int dis_to_head);
+long long nCr(int n, int k);
+int buildPrefixAdder(int n_bits, vector<NetGate>& gates);
+int buildHammingTree(const vector<vector<int>>& levels, int n_inputs, vector<NetGate>& gates, vector<int>& weights, int n_levels = INT_MAX);
+void countNetworkToffoli(const vector<NetGate>& gates, int n_wires, int& n_toffoli, int& toffoli_depth);
+void countAdderToffoli(int min_bit, ADDERTYPE adder_type, int& n_toffoli, int& toffoli_depth);
+float countSingleCost(int precision);
+float countAdderCost(int min_bit, const Config& config);
+float countAdderDepth(int min_bit, const Config& config);
+long long countCounterToffoli(int counter_size, int dis_to_head);
+long long countLookupToffoli(int width);
+float countCounterCost(int counter_size, int dis_to_head, const Config& config);
 void boothEncode(vector<int>& bit_string);
\ No newline at end of file
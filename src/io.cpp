@@ -24,14 +24,14 @@ float Optimizer::importBitList(const string& file_name) {
 		int lsb = 0;
 		while (getline(line_ss, word, ' ')) {
 			if (word == "1") {
-				if (!_is_same) {
+				if (!_config.isSame()) {
 					_bit_table[i].emplace_back(Bit(BITTYPE::POS, new_gate));
 					_heights[i]++;
 				}
 				lsb = i;
 			}
 			else if (word == "-1") {
-				if (!_is_same) {
+				if (!_config.isSame()) {
 					_bit_table[i].emplace_back(Bit(BITTYPE::NEG, new_gate));
 					_heights[i]++;
 				}
@@ -40,35 +40,474 @@ float Optimizer::importBitList(const string& file_name) {
 			i++;
 		}
 
-		if (_is_same) {
+		if (_config.isSame()) {
 			_bit_table[lsb].emplace_back(Bit(BITTYPE::POS, new_gate));
 			_heights[lsb]++;
 		}
 
-		adder_cost += countAdderCost(lsb);
+		adder_cost += countAdderCost(lsb, _config);
 	}
 
-	_n = _gate_list.size();
+	initialize();
 
-	if (_is_same) {
-		for (int i = 0; i < _r; ++i) {
-			if (_bit_table[i].size() != 0) {
-				_r = i + 1;
-				while (_heights.size() > _r) {
-					_heights.pop_back();
-					_n_carry.pop_back();
-					_n_counter.pop_back();
-					_n_split_from.pop_back();
-					_n_split_to.pop_back();
-					_counter_sizes.pop_back();
-					_bit_table.pop_back();
-				}
-				break;
+	return adder_cost;
+}
+
+/* ===== Function Description:
+	Get the rotation axis of a gate type (0: x-type, 1: y-type, 2: z-type).
+*/
+int getAxis(GATETYPE gate_type) {
+	if (gate_type == GATETYPE::RX || gate_type == GATETYPE::RXX) return 0;
+	if (gate_type == GATETYPE::RY || gate_type == GATETYPE::RYY) return 1;
+	return 2;
+}
+
+/* ===== Function Description:
+	Round a rotation angle into an r-bit binary fraction of a full turn (MSB first).
+	Return the rounded fraction.
+*/
+double angleToBits(double angle, int r, vector<int>& bit_string) {
+	angle = fmod(angle / M_PI / 2, 1);	// modulo a full turn, in (-1, 1)
+	angle = angle + 1 + pow(2, -1 - r);  // for rounding
+	angle -= floor(angle);		// between 0 and 1
+	double fraction = angle;
+
+	bit_string.resize(r);
+	for (int i = 0; i < r; ++i) {
+		angle = angle * 2;
+		if (angle > 1) {
+			bit_string[i] = 1;
+			angle -= 1;
+		}
+		else {
+			bit_string[i] = 0;
+		}
+	}
+	return fraction;
+}
+
+/* ===== Function Description:
+	Round an exact angle into an r-bit binary fraction of a full turn (MSB first) with integer arithmetic only.
+	Inexact angles are rounded as floating-point numbers.
+	Return the rounded fraction.
+*/
+double angleToBits(const Angle& angle, int r, vector<int>& bit_string) {
+	if (!angle.is_exact) return angleToBits(angle.radians, r, bit_string);
+
+	int k = angle.log_denominator;
+	unsigned long long mask = (k == 0) ? 0 : ((1ULL << k) - 1);
+	unsigned long long turns = (unsigned long long)angle.numerator & mask;	// in [0, 2^k), i.e., modulo a full turn
+	double fraction = ldexp((double)turns, -k) + pow(2, -1 - r);	// the same offset as the floating-point version
+	if (fraction >= 1) fraction -= 1;
+
+	bit_string.assign(r, 0);
+	if (r >= k) {
+		for (int i = 0; i < k; ++i) {
+			bit_string[i] = (turns >> (k - 1 - i)) & 1;
+		}
+	}
+	else {
+		unsigned long long rounded = (turns + (1ULL << (k - r - 1))) >> (k - r);	// round half up
+		for (int i = 0; i < r; ++i) {
+			bit_string[i] = (rounded >> (r - 1 - i)) & 1;
+		}	// the carry out of the MSB is a full turn
+	}
+	return fraction;
+}
+
+/* ===== Function Description:
+	Get an angle in turns, modulo a full turn, i.e., in [0, 1).
+*/
+long double angleToTurns(const Angle& angle) {
+	if (angle.is_exact) {
+		int k = angle.log_denominator;
+		return ldexpl((long double)((unsigned long long)angle.numerator & ((k == 0) ? 0 : ((1ULL << k) - 1))), -k);
+	}
+	long double turns = fmodl((long double)angle.radians / (2 * M_PIl), 1);
+	return (turns < 0) ? turns + 1 : turns;
+}
+
+/* ===== Function Description:
+	Get the error of rounding a rotation into 'precision' bits, i.e., the operator-norm distance 2 * sin(|d| / 4)
+	between the rotations up to a global phase, where d is the difference of the angles.
+	The errors of the gates add up to a bound on the error of the circuit.
+*/
+double roundingError(const Angle& angle, int precision) {
+	vector<int> bit_string;
+	angleToBits(angle, precision, bit_string);
+	long double rounded = 0;	// in turns
+	for (int i = 0; i < precision; ++i) {
+		if (bit_string[i] == 1) rounded += ldexpl(1, -1 - i);
+	}
+
+	long double difference = angleToTurns(angle) - rounded;
+	difference -= floorl(difference + 0.5L);		// modulo a full turn, in [-1/2, 1/2)
+	return 2 * sin((double)fabsl(difference) * 2 * M_PI / 4);
+}
+
+/* ===== Function Description:
+	Get the lowest precision (at most 'max_precision' bits) whose rounding error is at most 'max_error'.
+	Return 'max_precision' if 'max_error' is negative, i.e., the gate has no tolerated error.
+*/
+int precisionForError(const Angle& angle, double max_error, int max_precision) {
+	if (max_error < 0) return max_precision;
+	for (int precision = 0; precision < max_precision; ++precision) {
+		if (roundingError(angle, precision) <= max_error) return precision;
+	}
+	return max_precision;
+}
+
+class AngleTerm {	// a sub-expression of an angle, which is numerator / 2^log_denominator * pi^pi_power if exact
+public:
+	double value = 0;
+	bool is_exact = false;
+	long long numerator = 0;
+	int log_denominator = 0;
+	int pi_power = 0;
+};
+
+const __int128 ANGLE_NUMERATOR_LIMIT = (__int128)1 << 62;
+const int ANGLE_LOG_DENOMINATOR_LIMIT = 62;
+
+/* ===== Function Description:
+	Set the exact form of a term, or mark it as inexact if it is out of range.
+	The fraction is reduced, and a negative 'log_denominator' is multiplied into the numerator.
+*/
+void setExactTerm(AngleTerm& term, __int128 numerator, int log_denominator, int pi_power) {
+	term.is_exact = false;
+	if (pi_power < 0 || pi_power > 1) return;
+	while (log_denominator > 0 && numerator % 2 == 0) {
+		numerator /= 2;
+		log_denominator--;
+	}
+	for (; log_denominator < 0; ++log_denominator) {
+		numerator *= 2;
+		if (numerator >= ANGLE_NUMERATOR_LIMIT || numerator <= -ANGLE_NUMERATOR_LIMIT) return;
+	}
+	if (numerator >= ANGLE_NUMERATOR_LIMIT || numerator <= -ANGLE_NUMERATOR_LIMIT) return;
+	if (log_denominator > ANGLE_LOG_DENOMINATOR_LIMIT) return;
+
+	term.is_exact = true;
+	term.numerator = (long long)numerator;
+	term.log_denominator = log_denominator;
+	term.pi_power = (numerator == 0) ? 0 : pi_power;
+}
+
+/* ===== Function Description:
+	Parse a numeric literal (e.g., "3", "0.125", "1e-3") at 'pos'.
+	It is exact if it is a dyadic rational, i.e., D * 10^-m with D divisible by 5^m.
+*/
+bool parseAngleLiteral(const string& expression, size_t& pos, AngleTerm& term) {
+	size_t begin = pos;
+	string digits;
+	int exponent = 0;
+	bool has_dot = false;
+	for (; pos < expression.size() && (isdigit(expression[pos]) || (expression[pos] == '.' && !has_dot)); ++pos) {
+		if (expression[pos] == '.') {
+			has_dot = true;
+		}
+		else {
+			digits += expression[pos];
+			if (has_dot) exponent--;
+		}
+	}
+	if (digits.empty()) return false;
+	if (pos < expression.size() && (expression[pos] == 'e' || expression[pos] == 'E')) {
+		size_t end = pos + 1;
+		if (end < expression.size() && (expression[end] == '+' || expression[end] == '-')) end++;
+		if (end >= expression.size() || !isdigit(expression[end])) return false;
+		while (end < expression.size() && isdigit(expression[end])) end++;
+		exponent += stoi(expression.substr(pos + 1, end - pos - 1));
+		pos = end;
+	}
+	term.value = stod(expression.substr(begin, pos - begin));
+
+	// exact form
+	term.is_exact = false;
+	digits.erase(0, min(digits.find_first_not_of('0'), digits.size()));
+	while (!digits.empty() && digits.back() == '0') {
+		digits.pop_back();
+		exponent++;
+	}
+	if (digits.empty()) {
+		setExactTerm(term, 0, 0, 0);
+		return true;
+	}
+	if (digits.size() > 18 || exponent > 18 || exponent < -27) return true;
+
+	__int128 numerator = stoll(digits);
+	__int128 power_of_5 = 1;
+	for (int i = 0; i < abs(exponent); ++i) power_of_5 *= 5;
+	if (exponent >= 0) {
+		setExactTerm(term, numerator * power_of_5, -exponent, 0);
+	}
+	else if (numerator % power_of_5 == 0) {
+		setExactTerm(term, numerator / power_of_5, -exponent, 0);
+	}	// 10^-m = 2^-m * 5^-m
+	return true;
+}
+
+bool parseAngleSum(const string& expression, size_t& pos, AngleTerm& term);
+
+/* ===== Function Description:
+	Parse a primary expression at 'pos': a literal, "pi", a parenthesized expression, or a function call.
+	Function calls (sin, cos, tan, exp, ln, sqrt) are never exact.
+*/
+bool parseAnglePrimary(const string& expression, size_t& pos, AngleTerm& term) {
+	while (pos < expression.size() && isspace(expression[pos])) pos++;
+	if (pos >= expression.size()) return false;
+
+	if (isdigit(expression[pos]) || expression[pos] == '.') {
+		return parseAngleLiteral(expression, pos, term);
+	}
+	if (expression[pos] == '(') {
+		pos++;
+		if (!parseAngleSum(expression, pos, term)) return false;
+		while (pos < expression.size() && isspace(expression[pos])) pos++;
+		if (pos >= expression.size() || expression[pos] != ')') return false;
+		pos++;
+		return true;
+	}
+
+	size_t begin = pos;
+	while (pos < expression.size() && (isalnum(expression[pos]) || expression[pos] == '_')) pos++;
+	string name = expression.substr(begin, pos - begin);
+	if (name == "pi") {
+		term.value = M_PI;
+		setExactTerm(term, 1, 0, 1);
+		return true;
+	}
+
+	const map<string, double(*)(double)> functions = { {"sin", sin}, {"cos", cos}, {"tan", tan}, {"exp", exp}, {"ln", log}, {"sqrt", sqrt} };
+	if (functions.count(name) == 0) return false;
+	while (pos < expression.size() && isspace(expression[pos])) pos++;
+	if (pos >= expression.size() || expression[pos] != '(') return false;
+	if (!parseAnglePrimary(expression, pos, term)) return false;
+	term.value = functions.at(name)(term.value);
+	term.is_exact = false;
+	return true;
+}
+
+/* ===== Function Description:
+	Parse a unary expression at 'pos': signs followed by a primary with an optional power ("^").
+	A power is exact only for an exact number (without pi) to an integer exponent, e.g., "2^-3".
+*/
+bool parseAngleUnary(const string& expression, size_t& pos, AngleTerm& term) {
+	while (pos < expression.size() && isspace(expression[pos])) pos++;
+	if (pos < expression.size() && (expression[pos] == '-' || expression[pos] == '+')) {
+		bool is_neg = (expression[pos++] == '-');
+		if (!parseAngleUnary(expression, pos, term)) return false;
+		if (is_neg) {
+			term.value = -term.value;
+			term.numerator = -term.numerator;
+		}
+		return true;
+	}
+
+	if (!parseAnglePrimary(expression, pos, term)) return false;
+	while (pos < expression.size() && isspace(expression[pos])) pos++;
+	if (pos < expression.size() && expression[pos] == '^') {
+		pos++;
+		AngleTerm exponent;
+		if (!parseAngleUnary(expression, pos, exponent)) return false;
+		double value = pow(term.value, exponent.value);
+		bool is_exact = term.is_exact && term.pi_power == 0 && exponent.is_exact && exponent.pi_power == 0 && exponent.log_denominator == 0 && abs(exponent.numerator) <= ANGLE_LOG_DENOMINATOR_LIMIT;
+		AngleTerm base = term;
+		setExactTerm(term, 1, 0, 0);
+		for (long long i = 0; is_exact && i < abs(exponent.numerator); ++i) {
+			unsigned long long divisor = (base.numerator < 0) ? -(unsigned long long)base.numerator : base.numerator;
+			if (exponent.numerator > 0) {
+				setExactTerm(term, (__int128)term.numerator * base.numerator, term.log_denominator + base.log_denominator, 0);
+			}
+			else if (divisor != 0 && (divisor & (divisor - 1)) == 0) {
+				setExactTerm(term, (__int128)term.numerator * (base.numerator < 0 ? -1 : 1), term.log_denominator - base.log_denominator + __builtin_ctzll(divisor), 0);
+			}
+			else {
+				term.is_exact = false;
 			}
+			is_exact = term.is_exact;
 		}
+		term.value = value;
+		term.is_exact = is_exact;
 	}
+	return true;
+}
 
-	return adder_cost;
+/* ===== Function Description:
+	Parse a product at 'pos'.
+	A division is exact only if the divisor is a power of two (possibly times pi).
+*/
+bool parseAngleProduct(const string& expression, size_t& pos, AngleTerm& term) {
+	if (!parseAngleUnary(expression, pos, term)) return false;
+	while (true) {
+		while (pos < expression.size() && isspace(expression[pos])) pos++;
+		if (pos >= expression.size() || (expression[pos] != '*' && expression[pos] != '/')) return true;
+		bool is_division = (expression[pos++] == '/');
+
+		AngleTerm other;
+		if (!parseAngleUnary(expression, pos, other)) return false;
+		bool is_exact = term.is_exact && other.is_exact;
+		if (is_division) {
+			term.value /= other.value;
+			unsigned long long divisor = (other.numerator < 0) ? -(unsigned long long)other.numerator : other.numerator;
+			if (is_exact && divisor != 0 && (divisor & (divisor - 1)) == 0) {
+				int log_divisor = __builtin_ctzll(divisor);
+				setExactTerm(term, (__int128)term.numerator * (other.numerator < 0 ? -1 : 1), term.log_denominator - other.log_denominator + log_divisor, term.pi_power - other.pi_power);
+			}
+			else {
+				term.is_exact = false;
+			}
+		}
+		else {
+			term.value *= other.value;
+			if (is_exact) {
+				setExactTerm(term, (__int128)term.numerator * other.numerator, term.log_denominator + other.log_denominator, term.pi_power + other.pi_power);
+			}
+			else {
+				term.is_exact = false;
+			}
+		}
+	}
+}
+
+/* ===== Function Description:
+	Parse a sum at 'pos'.
+	A sum is exact if both terms are exact with the same power of pi (or one of them is zero).
+*/
+bool parseAngleSum(const string& expression, size_t& pos, AngleTerm& term) {
+	if (!parseAngleProduct(expression, pos, term)) return false;
+	while (true) {
+		while (pos < expression.size() && isspace(expression[pos])) pos++;
+		if (pos >= expression.size() || (expression[pos] != '+' && expression[pos] != '-')) return true;
+		int sign = (expression[pos++] == '-') ? -1 : 1;
+
+		AngleTerm other;
+		if (!parseAngleProduct(expression, pos, other)) return false;
+		term.value += sign * other.value;
+		if (term.is_exact && other.is_exact && (term.pi_power == other.pi_power || term.numerator == 0 || other.numerator == 0)) {
+			int log_denominator = max(term.log_denominator, other.log_denominator);
+			__int128 numerator = ((__int128)term.numerator << (log_denominator - term.log_denominator))
+				+ sign * ((__int128)other.numerator << (log_denominator - other.log_denominator));
+			setExactTerm(term, numerator, log_denominator, (term.numerator != 0) ? term.pi_power : other.pi_power);
+		}
+		else {
+			term.is_exact = false;
+		}
+	}
+}
+
+/* ===== Function Description:
+	Evaluate an openQASM angle expression (e.g., "pi/4", "-3*pi/8", "0.5*pi", "0.3").
+	Dyadic multiples of pi are kept exactly as fractions of a full turn, so that they are converted into bits without floating-point errors.
+	Return false if the expression cannot be parsed.
+*/
+bool parseAngle(const string& expression, Angle& angle) {
+	size_t pos = 0;
+	AngleTerm term;
+	if (!parseAngleSum(expression, pos, term)) return false;
+	while (pos < expression.size() && isspace(expression[pos])) pos++;
+	if (pos != expression.size() || !isfinite(term.value)) return false;
+
+	angle = Angle(term.value);
+	if (term.is_exact && (term.pi_power == 1 || term.numerator == 0) && term.log_denominator + 1 <= ANGLE_LOG_DENOMINATOR_LIMIT) {
+		angle.is_exact = true;
+		angle.numerator = term.numerator;
+		angle.log_denominator = (term.numerator == 0) ? 0 : term.log_denominator + 1;	// pi is half a turn
+		while (angle.log_denominator > 0 && angle.numerator % 2 == 0) {
+			angle.numerator /= 2;
+			angle.log_denominator--;
+		}
+		angle.radians = ldexp((double)angle.numerator, -angle.log_denominator) * 2 * M_PI;
+	}
+	return true;
+}
+
+/* ===== Function Description:
+	Parse a rotation gate from a (comment-stripped) openQASM line.
+	Return false if the line is not a supported rotation gate.
+*/
+bool parseRotation(const string& qasm_line, GATETYPE& gate_type, Angle& angle, vector<int>& qubits) {
+	size_t name_end = qasm_line.find_first_of(" (\t");
+	string word = qasm_line.substr(0, name_end);
+
+	// gate type
+	if (word == "rx")		gate_type = GATETYPE::RX;
+	else if (word == "ry")	gate_type = GATETYPE::RY;
+	else if (word == "rz")	gate_type = GATETYPE::RZ;
+	else if (word == "rxx") gate_type = GATETYPE::RXX;
+	else if (word == "ryy") gate_type = GATETYPE::RYY;
+	else if (word == "rzz") gate_type = GATETYPE::RZZ;
+	else if (word == "p")	gate_type = GATETYPE::P;
+	else if (word == "cp")	gate_type = GATETYPE::CP;
+	else					return false;
+
+	// rotation angle (between the matching parentheses)
+	size_t begin = qasm_line.find('(', name_end);
+	size_t end = begin;
+	for (int depth = 0; end != string::npos && end < qasm_line.size(); ++end) {
+		if (qasm_line[end] == '(') depth++;
+		else if (qasm_line[end] == ')' && --depth == 0) break;
+	}
+	if (begin == string::npos || end >= qasm_line.size()) {
+		cerr << "[Error]: The angle of \"" << qasm_line << "\" is not found." << endl;
+		exit(-1);
+	}
+	string expression = qasm_line.substr(begin + 1, end - begin - 1);
+	if (!parseAngle(expression, angle)) {
+		cerr << "[Error]: Cannot evaluate the angle \"" << expression << "\"." << endl;
+		exit(-1);
+	}
+
+	// qubits
+	qubits.clear();
+	stringstream line_ss(qasm_line.substr(end + 1));
+	getline(line_ss, word, '[');
+	while (getline(line_ss, word, ']')) {
+		qubits.emplace_back(stoi(word));
+		getline(line_ss, word, '[');
+	}
+	return true;
+}
+
+/* ===== Function Description:
+	Read a matrix of angle vectors for the sweep mode, in the binary format (kind 3) or as CSV,
+	where each CSV row is a point with comma-separated angle expressions, and empty rows and rows starting with '#' are skipped.
+	Return false with a message if the file cannot be read.
+*/
+bool readAngleMatrix(const string& file_name, vector<vector<Angle>>& points, string& message) {
+	points.clear();
+	if (isBinaryFile(file_name)) {
+		BinaryFile file(file_name);
+		if (!readBinaryAngleMatrix(file, points)) {
+			message = "malformed angle matrix";
+			return false;
+		}
+		return true;
+	}
+
+	ifstream in_file(file_name, ios::in);
+	if (!in_file.good()) {
+		message = "file \"" + file_name + "\" is not found";
+		return false;
+	}
+	string line;
+	for (int row = 1; getline(in_file, line); ++row) {
+		size_t begin = line.find_first_not_of(" \t\r");
+		if (begin == string::npos || line[begin] == '#') continue;
+
+		points.emplace_back();
+		stringstream line_ss(line);
+		string expression;
+		while (getline(line_ss, expression, ',')) {
+			Angle angle;
+			if (!parseAngle(expression.substr(0, expression.find_last_not_of(" \t\r") + 1), angle)) {
+				message = "cannot evaluate the angle \"" + expression + "\" in row " + to_string(row);
+				return false;
+			}
+			points.back().emplace_back(angle);
+		}
+	}
+	return true;
 }
 
 /* ===== Function Description:
@@ -76,8 +515,6 @@ float Optimizer::importBitList(const string& file_name) {
 */
 void Optimizer::importQasm(const string& file_name) {		// support gate set: RX, RY, RZ, RXX, RYY, RZZ, P, CP // GATETYPE
 	// parse qasm files (read bit table)
-	bool first_angle = true;
-
 	ifstream in_file(file_name, ios::in);
 	if (!in_file.good()) {
 		cerr << "File \"" << file_name << "\" is not found\n";
@@ -85,111 +522,20 @@ void Optimizer::importQasm(const string& file_name) {		// support gate set: RX,
 	}
 
 	string line;
-	vector<int> bit_string(_r);
 	while (getline(in_file, line)) {
 		line = line.substr(0, line.find("//"));
-		replace(line.begin(), line.end(), '(', ' ');
-		replace(line.begin(), line.end(), ')', ' ');
 		if (line.find_first_not_of("\t\n ") == string::npos) continue;
 
-		stringstream line_ss(line);
-		string word;
-		getline(line_ss, word, ' ');
-
-		if (word == "rx" || word == "ry" || word == "rz" || word == "rxx" || word == "ryy" || word == "rzz" || word == "p" || word == "cp") {
-			// gate type
-			GATETYPE gate_type;
-			if (word == "rx")		gate_type = GATETYPE::RX;
-			else if (word == "ry")	gate_type = GATETYPE::RY;
-			else if (word == "rz")	gate_type = GATETYPE::RZ;
-			else if (word == "rxx") gate_type = GATETYPE::RXX;
-			else if (word == "ryy") gate_type = GATETYPE::RYY;
-			else if (word == "rzz") gate_type = GATETYPE::RZZ;
-			else if (word == "p")	gate_type = GATETYPE::P;
-			else if (word == "cp")	gate_type = GATETYPE::CP;
-
-			// rotation angle
-			getline(line_ss, word, ' ');
-			double angle = stod(word);
-			angle = angle / M_PI / 2 + 1 + pow(2, -1 - _r);  // for rounding
-			if (angle >= 1) angle -= 1;		// between 0 and 1
-			if (_is_same == true && first_angle == false && angle != _last_angle) {
-				cerr << "All angles must be the same under the --all_same mode." << endl;
-				exit(-1);
-			}
-			first_angle = false;
-			_last_angle = angle;
-
-			// qubits
-			vector<int> qubits;
-			getline(line_ss, word, '[');
-			while (getline(line_ss, word, ']')) {
-				int var = stoi(word);
-				qubits.emplace_back(var);
-				getline(line_ss, word, '[');
-
-				if (gate_type == GATETYPE::RX || gate_type == GATETYPE::RXX) {
-					if (_involved_qubits_y.count(var) > 0 || _involved_qubits_z.count(var) > 0) {
-						cerr << "[Error]: Qubit " << var << " appears in gates with different rotation-axis type." << endl;
-						exit(-1);
-					}
-					_involved_qubits_x.insert(var);
-				}		
-				else if (gate_type == GATETYPE::RY || gate_type == GATETYPE::RYY) {
-					if (_involved_qubits_x.count(var) > 0 || _involved_qubits_z.count(var) > 0) {
-						cerr << "[Error]: Qubit " << var << " appears in gates with different rotation-axis type." << endl;
-						exit(-1);
-					}
-					_involved_qubits_y.insert(var);
-				}
-				else {
-					if (_involved_qubits_x.count(var) > 0 || _involved_qubits_y.count(var) > 0) {
-						cerr << "[Error]: Qubit " << var << " appears in gates with different rotation-axis type." << endl;
-						exit(-1);
-					}
-					_involved_qubits_z.insert(var);
-				}									
-			}
-
-			// process
-			Gate* new_gate = new Gate((int)_gate_list.size(), gate_type, qubits);
-			_gate_list.emplace_back(new_gate);
-
-			for (int i = 0; i < _r; ++i) {
-				angle = angle * 2;
-				if (angle > 1) {
-					bit_string[i] = 1;
-					angle -= 1;
-				}
-				else {
-					bit_string[i] = 0;
-				}
-			}
-
-			if (_is_same) {
-				int lsb;
-				for (lsb = _r - 1; lsb >= 0; --lsb) {
-					if (bit_string[lsb] == 1)
-						break;
-				}
-				_bit_table[lsb].emplace_back(Bit(BITTYPE::POS, new_gate));
-				_heights[lsb]++;
-			}
-			else {
-				boothEncode(bit_string);
-				for (int i = 0; i < _r; ++i) {
-					if (bit_string[i] == 1) {
-						_bit_table[i].emplace_back(Bit(BITTYPE::POS, new_gate));
-						_heights[i]++;
-					}
-					else if (bit_string[i] == -1) {
-						_bit_table[i].emplace_back(Bit(BITTYPE::NEG, new_gate));
-						_heights[i]++;
-					}
-				}
-			}
+		GATETYPE gate_type;
+		Angle angle;
+		vector<int> qubits;
+		if (parseRotation(line, gate_type, angle, qubits)) {
+			addGate(gate_type, angle, qubits);
+			continue;
 		}
-		else if (word == "qreg" || word == "creg" || word == "OPENQASM" || word == "include") {
+
+		string word = line.substr(0, line.find_first_of(" ("));
+		if (word == "qreg" || word == "creg" || word == "OPENQASM" || word == "include") {
 			_headers.emplace_back(line);
 			continue;
 		}
@@ -198,11 +544,71 @@ void Optimizer::importQasm(const string& file_name) {		// support gate set: RX,
 		}
 	}
 
-	// initialization
+	initialize();
+}
+
+/* ===== Function Description:
+	Add a rotation gate and write its bits into the bit table.
+	The angle is rounded into 'precision' bits (at most the precision of the optimizer), leaving the lower columns empty.
+*/
+void Optimizer::addGate(GATETYPE gate_type, const Angle& angle, const vector<int>& qubits, int precision) {
+	precision = _config.isSame() ? _r : min(precision, _r);		// the same angles are not truncated
+	vector<int> bit_string;
+	double fraction = angleToBits(angle, precision, bit_string);
+	bit_string.resize(_r, 0);
+	if (_config.isSame() == true && !_gate_list.empty() && fraction != _last_angle) {
+		cerr << "All angles must be the same under the --all_same mode." << endl;
+		exit(-1);
+	}
+	_last_angle = fraction;
+
+	// rotation-axis type of the qubits
+	set<int>* axis_sets[3] = { &_involved_qubits_x, &_involved_qubits_y, &_involved_qubits_z };
+	int axis = getAxis(gate_type);
+	for (int var : qubits) {
+		if (axis_sets[(axis + 1) % 3]->count(var) > 0 || axis_sets[(axis + 2) % 3]->count(var) > 0) {
+			cerr << "[Error]: Qubit " << var << " appears in gates with different rotation-axis type." << endl;
+			exit(-1);
+		}
+		axis_sets[axis]->insert(var);
+	}
+
+	// process
+	Gate* new_gate = new Gate((int)_gate_list.size(), gate_type, qubits, precision);
+	_gate_list.emplace_back(new_gate);
+
+	if (_config.isSame()) {
+		int lsb;
+		for (lsb = _r - 1; lsb >= 0; --lsb) {
+			if (bit_string[lsb] == 1)
+				break;
+		}
+		_bit_table[lsb].emplace_back(Bit(BITTYPE::POS, new_gate));
+		_heights[lsb]++;
+	}
+	else {
+		boothEncode(bit_string);
+		for (int i = 0; i < _r; ++i) {
+			if (bit_string[i] == 1) {
+				_bit_table[i].emplace_back(Bit(BITTYPE::POS, new_gate));
+				_heights[i]++;
+			}
+			else if (bit_string[i] == -1) {
+				_bit_table[i].emplace_back(Bit(BITTYPE::NEG, new_gate));
+				_heights[i]++;
+			}
+		}
+	}
+}
+
+/* ===== Function Description:
+	Finish importing gates and initialize the remaining states.
+*/
+void Optimizer::initialize() {
 	_n = _gate_list.size();
 
 	// remove redundant bits for special case
-	if (_is_same) {
+	if (_config.isSame()) {
 		for (int i = 0; i < _r; ++i) {
 			if (_bit_table[i].size() != 0) {
 				_r = i + 1;
@@ -221,31 +627,160 @@ void Optimizer::importQasm(const string& file_name) {		// support gate set: RX,
 	}
 }
 
+/* ===== Function Description:  // O(n_passes * _n * _r)
+	Choose the signed-digit forms of all angles jointly to flatten the height profile, instead of the Booth encoding of each angle alone.
+	The forms of an angle are the strings of digits in {-1, 0, 1} with its value modulo a full turn within its precision.
+	In each pass, every gate is taken out of the table, and its cheapest form is found by dynamic programming over the carry from the LSB,
+	where a digit costs the increase of the adder-cost proxy (the sum of 'countAdderCost' over the rows, the k-th row reaching
+	the lowest column of height at least k), plus a penalty if it raises the peak height.
+	The new form is kept only if it lowers the peak height, the proxy at the same peak, or the number of bits at the same proxy.
+*/
+void Optimizer::recode() {
+	if (_config.isSame()) return;		// a single bit per gate
+
+	const int n_passes = 8;
+	const double penalty = 1e9;
+
+	vector<vector<int>> digits(_n, vector<int>(_r, 0));		// gate id -> signed digits (MSB first)
+	for (int i = 0; i < _r; ++i) {
+		for (Bit& bit : _bit_table[i]) {
+			digits[bit.getGateId()][i] = bit.isPos() ? 1 : -1;
+		}
+	}
+	vector<float> adder_costs(_r);
+	for (int i = 0; i < _r; ++i) adder_costs[i] = countAdderCost(i, _config);
+	vector<int> heights = _heights;
+	auto add_digits = [&](const vector<int>& gate_digits, int sign) {
+		for (int i = 0; i < _r; ++i) {
+			if (gate_digits[i] != 0) heights[i] += sign;
+		}
+	};
+
+	// (peak height, proxy, number of bits), where 'lowest[k]' is the lowest column of the (k + 1)-th row
+	vector<int> lowest;
+	auto evaluate = [&]() {
+		lowest.clear();
+		float proxy = 0;
+		int n_bits = 0;
+		for (int i = _r - 1; i >= 0; --i) {
+			while (lowest.size() < heights[i]) {
+				lowest.push_back(i);
+				proxy += adder_costs[i];
+			}
+			n_bits += heights[i];
+		}
+		return make_tuple((int)lowest.size(), proxy, n_bits);
+	};
+
+	auto current = evaluate();
+	vector<double> weights(_r);
+	vector<int> bits(_r), new_digits(_r);
+	vector<array<int, 2>> prev_carries(_r), prev_digits(_r);
+	bool is_changed = true;
+	for (int pass = 0; pass < n_passes && is_changed; ++pass) {
+		is_changed = false;
+		for (int g = 0; g < _n; ++g) {
+			int precision = min(_gate_list[g]->getPrecision(), _r);
+			add_digits(digits[g], -1);
+			evaluate();
+			int peak = lowest.size();
+			for (int i = 0; i < precision; ++i) {
+				if (heights[i] >= peak)	weights[i] = penalty + adder_costs[i];
+				else					weights[i] = adder_costs[max(i, lowest[heights[i]])] - adder_costs[lowest[heights[i]]];
+			}
+
+			// binary digits of the value
+			int carry = 0;
+			for (int i = precision - 1; i >= 0; --i) {
+				int t = digits[g][i] + carry;
+				bits[i] = t & 1;
+				carry = (t - bits[i]) / 2;
+			}
+
+			// cheapest form by (cost, number of bits) for each carry into the next column, where the carry out of the MSB is a full turn
+			pair<double, int> costs[2] = { make_pair(0.0, 0), make_pair(penalty * _r * 2, 0) };
+			for (int i = precision - 1; i >= 0; --i) {
+				pair<double, int> next_costs[2] = { make_pair(penalty * _r * 2, 0), make_pair(penalty * _r * 2, 0) };
+				for (int c = 0; c < 2; ++c) {
+					int t = bits[i] + c;
+					for (int d = -1; d <= 1; ++d) {
+						if ((t - d) % 2 != 0 || t - d < 0 || t - d > 2) continue;
+						int next_carry = (t - d) / 2;
+						pair<double, int> cost = (d == 0) ? costs[c] : make_pair(costs[c].first + weights[i], costs[c].second + 1);
+						if (cost < next_costs[next_carry]) {
+							next_costs[next_carry] = cost;
+							prev_carries[i][next_carry] = c;
+							prev_digits[i][next_carry] = d;
+						}
+					}
+				}
+				costs[0] = next_costs[0];
+				costs[1] = next_costs[1];
+			}
+			fill(new_digits.begin(), new_digits.end(), 0);
+			for (int i = 0, c = (costs[1] < costs[0]) ? 1 : 0; i < precision; ++i) {
+				new_digits[i] = prev_digits[i][c];
+				c = prev_carries[i][c];
+			}
+
+			if (new_digits == digits[g]) {
+				add_digits(digits[g], 1);
+				continue;
+			}
+			add_digits(new_digits, 1);
+			auto recoded = evaluate();
+			if (recoded < current) {
+				current = recoded;
+				digits[g] = new_digits;
+				is_changed = true;
+			}
+			else {
+				add_digits(new_digits, -1);
+				add_digits(digits[g], 1);
+			}
+		}
+	}
+
+	for (int i = 0; i < _r; ++i) {
+		_bit_table[i].clear();
+		for (int g = 0; g < _n; ++g) {
+			if (digits[g][i] != 0) _bit_table[i].emplace_back(Bit(digits[g][i] == 1 ? BITTYPE::POS : BITTYPE::NEG, _gate_list[g]));
+		}
+		_heights[i] = _bit_table[i].size();
+	}
+}
+
 /* ===== Function Description:
 	Do Fourier-state transformation for the special case.
+	Return the cost.
 */
-void Optimizer::exportQasmFourierTrans(ofstream& ofs, bool is_reverted) {
+float Optimizer::exportQasmFourierTrans(ostream& ofs, bool is_reverted) {
   double c = 1 - (int)(_last_angle * pow(2, _r));
+  float cost = 0;
   
 	for (int i = 0; i < _r; ++i) {
-    double angle = M_PI * c;//fmod(c, 2);
+    double angle = M_PI * fmod(c, 2) + 0.0;	// exact, since c is a dyadic rational (+0.0 avoids "-0")
     
+		ofs << setprecision(numeric_limits<double>::max_digits10);
 		if (is_reverted) {	// cost is not counted
-			ofs << "p(" << -angle << ") frs[" << i << "];\n";
+			ofs << "p(" << 0.0 - angle << ") frs[" << i << "];\n";
 		}
 		else {
 			ofs << "p(" << angle << ") frs[" << i << "];\n";
-			_cost += _cost_single;
+			cost += _config.getCostSingle();
 		}
+		ofs << setprecision(6);
     c /= 2; 
 	}
+	_cost += cost;
+	return cost;
 }
 
 
 /* ===== Function Description:
 	Do rotation-type transformation between x/y-type and z-type.
 */
-void Optimizer::exportQasmRotTypeTrans(ofstream& ofs, bool is_reverted) {
+void Optimizer::exportQasmRotTypeTrans(ostream& ofs, bool is_reverted) {
 	for (int qubit : _involved_qubits_x) {
 		ofs << "h q[" << qubit << "];\n";
 	}
@@ -262,87 +797,260 @@ void Optimizer::exportQasmRotTypeTrans(ofstream& ofs, bool is_reverted) {
 }	
 
 /* ===== Function Description:
-	Set the representative ancilla qubits for two-qubit gates.
+	Name the qubit representing each gate and plan the lifetimes of the representative ancillas.
+	Two-qubit gates are represented by ancilla qubits,
+	which are computed before the first adder row using them and uncomputed after the last one.
+	So are the products of the counters (see 'planProducts'), which are computed after the representative ancillas of the row.
+	The table lookups are written after the adder rows, and the excluded single rotations are written last.
+	Ancilla indices are recycled, so the "anc" register only needs the peak number of live ancillas.
 */
-void Optimizer::exportQasmSetAnc(ofstream& ofs, bool is_reverted) {
-	int ith_anc = 0;
-	for (Gate* gate : _gate_list) {
-		if (gate->getTypeStr() == "rxx" || gate->getTypeStr() == "ryy" || gate->getTypeStr() == "rzz") {
-			ofs << "cx q[" << gate->getQubit(0) << "], anc[" << ith_anc << "];\n";
-			ofs << "cx q[" << gate->getQubit(1) << "], anc[" << ith_anc << "];\n";
-			if (!is_reverted) gate->setName("anc[" + to_string(ith_anc) + "]");
-			ith_anc++;
+void Optimizer::allocateAncilla() {
+	_n_rows = 0;
+	for (int i = 0; i < _r; ++i) {
+		_n_rows = max(_n_rows, (int)_bit_table[i].size());
+	}
+
+	// lifetimes of the representative qubits
+	int n_rows = _n_rows + _lookups.size();
+	vector<int> first_row(_n, -1), last_row(_n, -1);
+	for (int row = 0; row <= n_rows; ++row) {
+		vector<int> used_gates;
+		if (row >= _n_rows && row < n_rows) {
+			used_gates = _lookups[row - _n_rows].gate_ids;
 		}
-		else if (gate->getTypeStr() == "cp") {
-			ofs << "ccx q[" << gate->getQubit(0) << "], q[" << gate->getQubit(1) << "], anc[" << ith_anc << "];\n";
-			if (!is_reverted) _cost += COST_TOFFOLI;
-			if (!is_reverted) gate->setName("anc[" + to_string(ith_anc) + "]");
-			ith_anc++;
+		else if (row < _n_rows) {
+			for (int i = 0; i < _r; ++i) {
+				if (_bit_table[i].size() <= row) continue;
+				const Bit& bit = _bit_table[i][row];
+				if (bit.getType() != BITTYPE::CAR) {
+					used_gates.emplace_back(bit.getGateId());
+					continue;
+				}
+				for (const Bit& carry_in : bit.getCarryIns()) {
+					used_gates.emplace_back(carry_in.getGateId());
+				}
+			}
+		}
+		else {	// single rotations
+			for (auto item : _excluded) {
+				used_gates.emplace_back(item.first);
+			}
+		}
+		for (int gate_id : used_gates) {
+			if (first_row[gate_id] == -1) first_row[gate_id] = row;
+			last_row[gate_id] = row;
+		}
+	}
+
+	// assign the smallest free index to each ancilla in the order of the lifetimes
+	_anc_computed = vector<vector<int>>(n_rows + 1);
+	_anc_uncomputed = vector<vector<int>>(n_rows + 1);
+	for (Gate* gate : _gate_list) {
+		int gate_id = gate->getId();
+		if (gate->getTypeStr() == "rxx" || gate->getTypeStr() == "ryy" || gate->getTypeStr() == "rzz" || gate->getTypeStr() == "cp") {
+			if (first_row[gate_id] == -1) continue;		// not used
+			_anc_computed[first_row[gate_id]].emplace_back(gate_id);
+			_anc_uncomputed[last_row[gate_id]].emplace_back(gate_id);
 		}
 		else {
-			if (!is_reverted) gate->setName("q[" + to_string(gate->getQubit(0)) + "]");
+			gate->setName("q[" + to_string(gate->getQubit(0)) + "]");
 		}
 	}
+
+	planProducts();
+
+	set<int> free_indices;
+	vector<int> anc_index(_n, -1);
+	vector<int> product_index(_products.size(), -1);
+	_n_ancilla = 0;
+	auto allocate = [&]() {
+		if (free_indices.empty()) return _n_ancilla++;
+		int index = *free_indices.begin();
+		free_indices.erase(free_indices.begin());
+		return index;
+	};
+	for (int row = 0; row <= n_rows; ++row) {
+		for (int gate_id : _anc_computed[row]) {
+			anc_index[gate_id] = allocate();
+			_gate_list[gate_id]->setName("anc[" + to_string(anc_index[gate_id]) + "]");
+		}
+		for (int id : _products_computed[row]) {
+			product_index[id] = allocate();
+			_products[id].name = "anc[" + to_string(product_index[id]) + "]";
+		}
+		for (int id : _products_uncomputed[row]) {
+			free_indices.insert(product_index[id]);
+		}
+		for (int gate_id : _anc_uncomputed[row]) {
+			free_indices.insert(anc_index[gate_id]);
+		}
+	}
+	for (Product& product : _products) {
+		if (product.halves[0] != -1) continue;
+		int factor = product.literals[0].first;
+		product.name = (factor < 0) ? "q[" + to_string(-1 - factor) + "]" : _gate_list[factor]->getName();
+	}
 }
 
 /* ===== Function Description:
-	Write counter circuits.
+	Plan the products of the counters as shared AND-trees.
+	The k-th carry of a counter (k = 2^power) is the parity of the products of its k-subsets of carry-ins,
+	where a NEG bit of a gate is the factor (1 - the representative qubit).
+	The products are identified by their factors (the single-qubit gates on a qubit share the factor of the qubit),
+	so that equal ones of any counters are stored once:
+	a product of a 2k-subset is the logical AND of the stored products of its two k-subsets,
+	products with both factors of a gate are 0 and skipped, and products of one factor are the qubits themselves.
+	Products appearing an even number of times in a counter bit cancel out.
+	Each stored product lives from the first row using it (or a product of it) to the last one.
 */
-void Optimizer::exportCounter(ofstream& ofs, const vector<Bit>& carry_ins, vector<int>& selected, int k, string& target_name, bool is_reverted) {
-	if (selected.size() == k) {
-		set<string> pos_gates, neg_gates;
-		for (int ith_bit : selected) {
-			if (carry_ins[ith_bit].getType() == BITTYPE::POS) {
-				pos_gates.insert(carry_ins[ith_bit].getName());
-			}
-			else {
-				neg_gates.insert(carry_ins[ith_bit].getName());
-			}
+void Optimizer::planProducts() {
+	int n_rows = _n_rows + _lookups.size();
+	_products.clear();
+	_products_computed = vector<vector<int>>(n_rows + 1);
+	_products_uncomputed = vector<vector<int>>(n_rows + 1);
+	_counter_terms = vector<vector<vector<int>>>(_r);
+	if (_is_hamming) return;	// written by 'exportQasmWriteHamming'
+
+	map<vector<pair<int, bool>>, int> product_ids;		// factors -> index in '_products'
+	function<int(const vector<Bit>&, const vector<int>&, int, int)> get_product = [&](const vector<Bit>& carry_ins, const vector<int>& subset, int begin, int end) {
+		vector<pair<int, bool>> literals;
+		for (int j = begin; j < end; ++j) {
+			Gate* gate = _gate_list[carry_ins[subset[j]].getGateId()];
+			int factor = (gate->getNumQubits() == 1) ? -1 - gate->getQubit(0) : gate->getId();
+			literals.emplace_back(factor, carry_ins[subset[j]].getType() == BITTYPE::NEG);
 		}
-		set<string> excluded;
-		for (string s : pos_gates) {
-			if (neg_gates.count(s) != 0) {
-				excluded.insert(s);
+		sort(literals.begin(), literals.end());
+		literals.erase(unique(literals.begin(), literals.end()), literals.end());
+		for (int j = 1; j < literals.size(); ++j) {
+			if (literals[j].first == literals[j - 1].first) return -1;	// x * (1 - x) = 0
+		}
+		auto it = product_ids.find(literals);
+		if (it != product_ids.end()) return it->second;
+
+		Product product;
+		product.literals = literals;
+		if (literals.size() > 1) {
+			int middle = (begin + end) / 2;
+			product.halves[0] = get_product(carry_ins, subset, begin, middle);
+			product.halves[1] = get_product(carry_ins, subset, middle, end);
+			for (int h = 0; h < 2; ++h) {
+				if (_products[product.halves[h]].literals == literals) return product_ids[literals] = product.halves[h];
 			}
 		}
-		if (pos_gates.size() + neg_gates.size() - 2 * excluded.size() == 0) return;
+		_products.emplace_back(product);
+		return product_ids[literals] = _products.size() - 1;
+	};
 
-		for (string s : neg_gates)
-			if (excluded.count(s) == 0)
-				ofs << "x " << s << ";\n";
+	vector<int> first_row, last_row;
+	for (int i = 0; i < _r; ++i) {
+		_counter_terms[i].resize(_bit_table[i].size());
+		for (int row = 0; row < _bit_table[i].size(); ++row) {
+			const Bit& bit = _bit_table[i][row];
+			if (bit.getType() != BITTYPE::CAR) continue;
 
-		if (pos_gates.size() + neg_gates.size() - 2 * excluded.size() == 1)			ofs << "cx ";
-		else if (pos_gates.size() + neg_gates.size() - 2 * excluded.size() == 2)	ofs << "ccx ";
-		else 																		ofs << "mcx ";
-			
-		if (!is_reverted && pos_gates.size() + neg_gates.size() - 2 * excluded.size() > 1) _cost += COST_TOFFOLI;	// a bound
-		// Note that by storing target bits of previous k/2-controlled Toffoli gates, 
-		// k-controlled Toffoli gates with k > 2 can be obtained by a single 2-controlled Toffoli gate
+			const vector<Bit>& carry_ins = bit.getCarryIns();
+			int k = 1 << bit.getPower();
+			if (k > carry_ins.size()) continue;
+			map<int, int> n_terms;		// product -> #k-subsets with the product
+			vector<int> subset(k);
+			iota(subset.begin(), subset.end(), 0);
+			while (true) {
+				int id = get_product(carry_ins, subset, 0, k);
+				if (id != -1) n_terms[id]++;
 
-		for (auto s : pos_gates)
-			ofs << s << ", ";
-		for (auto s : neg_gates)
-			ofs << s << ", ";
-		ofs << target_name << ";\n";
+				int j = k - 1;		// the next k-subset in the lexicographic order
+				while (j >= 0 && subset[j] == carry_ins.size() - k + j) j--;
+				if (j < 0) break;
+				subset[j]++;
+				for (int l = j + 1; l < k; ++l) subset[l] = subset[l - 1] + 1;
+			}
 
-		for (string s : neg_gates)
-			if (excluded.count(s) == 0)
-				ofs << "x " << s << ";\n";
-		return;
+			first_row.resize(_products.size(), -1);
+			last_row.resize(_products.size(), -1);
+			for (auto& item : n_terms) {
+				if (item.second % 2 == 0) continue;
+				_counter_terms[i][row].emplace_back(item.first);
+				if (first_row[item.first] == -1 || first_row[item.first] > row) first_row[item.first] = row;
+				last_row[item.first] = max(last_row[item.first], row);
+			}
+		}
 	}
 
-	int start = selected.empty() ? 0 : (selected.back() + 1);
-	for (int i = start; i < carry_ins.size(); ++i) {
-		selected.emplace_back(i);
-		exportCounter(ofs, carry_ins, selected, k, target_name, is_reverted);
-		selected.pop_back();
+	// the halves of a product live at least as long as it, and the halves are created before it
+	first_row.resize(_products.size(), -1);
+	last_row.resize(_products.size(), -1);
+	for (int id = _products.size() - 1; id >= 0; --id) {
+		if (first_row[id] == -1 || _products[id].halves[0] == -1) continue;
+		for (int half : _products[id].halves) {
+			if (first_row[half] == -1 || first_row[half] > first_row[id]) first_row[half] = first_row[id];
+			last_row[half] = max(last_row[half], last_row[id]);
+		}
+	}
+	for (int id = 0; id < _products.size(); ++id) {
+		if (first_row[id] == -1 || _products[id].halves[0] == -1) continue;
+		_products_computed[first_row[id]].emplace_back(id);
+	}
+	for (int id = _products.size() - 1; id >= 0; --id) {
+		if (first_row[id] == -1 || _products[id].halves[0] == -1) continue;
+		_products_uncomputed[last_row[id]].emplace_back(id);
 	}
 }
 
 /* ===== Function Description:
-	Set adder bits.
+	Compute the representative ancillas used from the 'row'-th adder row,
+	or uncompute the ones last used in the 'row'-th adder row if 'is_reverted' is true.
 */
-int Optimizer::exportQasmSetAdderBits(ofstream& ofs, int ith_adder, bool is_reverted) {
+void Optimizer::exportQasmSetAnc(ostream& ofs, int row, bool is_reverted) {
+	for (int gate_id : (is_reverted ? _anc_uncomputed[row] : _anc_computed[row])) {
+		Gate* gate = _gate_list[gate_id];
+		if (gate->getTypeStr() == "rxx" || gate->getTypeStr() == "ryy" || gate->getTypeStr() == "rzz") {
+			ofs << "cx q[" << gate->getQubit(0) << "], " << gate->getName() << ";\n";
+			ofs << "cx q[" << gate->getQubit(1) << "], " << gate->getName() << ";\n";
+		}
+		else if (gate->getTypeStr() == "cp") {
+			string a = "q[" + to_string(gate->getQubit(0)) + "]";
+			string b = "q[" + to_string(gate->getQubit(1)) + "]";
+			if (is_reverted) {
+				exportQasmUnand(ofs, a, b, gate->getName());
+			}
+			else {
+				exportQasmAnd(ofs, a, b, gate->getName());
+				_cost += _config.getCostToffoli();
+			}
+		}
+	}
+}
+
+/* ===== Function Description:
+	Compute the products of the counters used from the 'row'-th adder row by logical-AND gates,
+	or uncompute the ones last used in the 'row'-th adder row if 'is_reverted' is true.
+*/
+void Optimizer::exportQasmSetProducts(ostream& ofs, int row, bool is_reverted) {
+	for (int id : (is_reverted ? _products_uncomputed[row] : _products_computed[row])) {
+		const Product& product = _products[id];
+		const Product& a = _products[product.halves[0]];
+		const Product& b = _products[product.halves[1]];
+		for (const Product* half : { &a, &b }) {
+			if (half->halves[0] == -1 && half->literals[0].second) ofs << "x " << half->name << ";\n";
+		}
+		if (is_reverted) {
+			exportQasmUnand(ofs, a.name, b.name, product.name);
+		}
+		else {
+			exportQasmAnd(ofs, a.name, b.name, product.name);
+			_cost += _config.getCostToffoli();
+		}
+		for (const Product* half : { &a, &b }) {
+			if (half->halves[0] == -1 && half->literals[0].second) ofs << "x " << half->name << ";\n";
+		}
+	}
+}
+
+/* ===== Function Description:
+	Set adder bits, or unset them after the adder, since the gates are their own inverses.
+	A counter bit is the parity of the stored products of its counter (see 'planProducts'), which is set by CNOT gates.
+*/
+int Optimizer::exportQasmSetAdderBits(ostream& ofs, int ith_adder) {
 	int last_bit = -1;
 	for (int i = 0; i < _r; ++i) {
 		if (_bit_table[i].size() > ith_adder) {
@@ -355,9 +1063,13 @@ int Optimizer::exportQasmSetAdderBits(ofstream& ofs, int ith_adder, bool is_reve
 				ofs << "cx " << _bit_table[i][ith_adder].getName() << ", add[" << i << "];\n";
 			}
 			else {	// BITTYPE::CAR
-				vector<int> selected;
-				string target = "add[" + to_string(i) + "]";
-				exportCounter(ofs, _bit_table[i][ith_adder].getCarryIns(), selected, pow(2, _bit_table[i][ith_adder].getPower()), target, is_reverted);
+				for (int id : _counter_terms[i][ith_adder]) {
+					const Product& product = _products[id];
+					bool is_neg = (product.halves[0] == -1 && product.literals[0].second);
+					if (is_neg) ofs << "x " << product.name << ";\n";
+					ofs << "cx " << product.name << ", add[" << i << "];\n";
+					if (is_neg) ofs << "x " << product.name << ";\n";
+				}
 			}
 		}
 	}
@@ -365,90 +1077,539 @@ int Optimizer::exportQasmSetAdderBits(ofstream& ofs, int ith_adder, bool is_reve
 }
 
 /* ===== Function Description:
-	Write adders.
+	Write the adder of the 'ith_adder'-th row.
 */
-void Optimizer::exportQasmWriteAdder(ofstream& ofs) {
-	for (int ith_adder = 0; true; ++ith_adder) {
-		int last_bit = exportQasmSetAdderBits(ofs, ith_adder, false);
-		if (last_bit == -1) break;
-		//ofs << "barrier;\n";
+void Optimizer::exportQasmWriteAdder(ostream& ofs, int ith_adder) {
+	if (_is_hamming) {
+		exportQasmWriteHamming(ofs);
+		return;
+	}
+	int last_bit = exportQasmSetAdderBits(ofs, ith_adder);
+	if (last_bit == -1) return;
+	//ofs << "barrier;\n";
+
+	if (_config.getAdderType() == ADDERTYPE::PREFIX)	exportQasmWritePrefixAdder(ofs, last_bit);
+	else												exportQasmWriteRippleAdder(ofs, last_bit);
+
+	//ofs << "barrier;\n";
+	exportQasmSetAdderBits(ofs, ith_adder);	 // unset
+}
 
-		// main adder
-		for (int i = last_bit; i > 0; --i) { // MAJ
-			ofs << "cx add[" << i << "], frs[" << i << "];\n";
-			ofs << "cx add[" << i << "], add[" << i + 1 << "];\n";
+/* ===== Function Description:
+	Write the adder row of Hamming-weight phasing: the weight of the representative qubits is computed into the "hw" register by 'buildHammingTree',
+	loaded into the "add" register, added into the "frs" register, and then unloaded and uncomputed.
+	The carry-save compressor is written in the same way, where the representative qubits of NEG inputs are flipped meanwhile.
+*/
+void Optimizer::exportQasmWriteHamming(ostream& ofs) {
+	vector<NetGate> gates;
+	vector<int> weights;
+	int last_bit;
+	int n_ancilla = buildHamming(gates, weights, last_bit);
+	vector<string> names(_n + n_ancilla);
+	for (int gate_id = 0; gate_id < _n; ++gate_id) {
+		names[gate_id] = _gate_list[gate_id]->getName();
+	}
+	for (int k = 0; k < n_ancilla; ++k) {
+		names[_n + k] = "hw[" + to_string(k) + "]";
+	}
+
+	set<string> flipped;
+	for (int i = 0; i < _r; ++i) {
+		if (_bit_table[i].empty()) continue;
+		for (const Bit& carry_in : _bit_table[i][0].getCarryIns()) {
+			if (carry_in.getType() == BITTYPE::NEG) flipped.insert(carry_in.getName());
+		}
+	}
+
+	vector<char> is_zero(_n + n_ancilla, false);
+	fill(is_zero.begin() + _n, is_zero.end(), true);
+	auto set_adder_bits = [&]() {
+		for (int j = 0; j < weights.size() && _r - 1 - j >= 0; ++j) {
+			if (weights[j] != -1) ofs << "cx " << names[weights[j]] << ", add[" << _r - 1 - j << "];\n";
+		}
+	};
+
+	for (const string& name : flipped) ofs << "x " << name << ";\n";
+	for (NetGate& gate : gates) exportQasmNetGate(ofs, gate, names, false, is_zero);
+	set_adder_bits();
+	if (last_bit != -1) {
+		if (_config.getAdderType() == ADDERTYPE::PREFIX)	exportQasmWritePrefixAdder(ofs, last_bit);
+		else												exportQasmWriteRippleAdder(ofs, last_bit);
+	}
+	set_adder_bits();
+	for (int i = gates.size() - 1; i >= 0; --i) exportQasmNetGate(ofs, gates[i], names, true, is_zero);
+	for (const string& name : flipped) ofs << "x " << name << ";\n";
+}
+
+/* ===== Function Description:
+	Write a ripple-carry adder adding "add[0..last_bit]" into "frs[0..last_bit]".
+	If the circuit is lowered, the Toffoli gate of each MAJ is a logical-AND gate kept in the "tmp" register until the UMS,
+	which uncomputes it by a measurement [C. Gidney, 2018].
+*/
+void Optimizer::exportQasmWriteRippleAdder(ostream& ofs, int last_bit) {
+	vector<string> ands(last_bit + 1);
+	for (int i = last_bit; i > 0; --i) { // MAJ
+		ofs << "cx add[" << i << "], frs[" << i << "];\n";
+		ofs << "cx add[" << i << "], add[" << i + 1 << "];\n";
+		if (_is_lowered) {
+			ands[i] = allocateScratch();
+			exportQasmAnd(ofs, "add[" + to_string(i + 1) + "]", "frs[" + to_string(i) + "]", ands[i]);
+			ofs << "cx " << ands[i] << ", add[" << i << "];\n";
+		}
+		else {
 			ofs << "ccx add[" << i + 1 << "], frs[" << i << "], add[" << i << "]; \n";
-			_cost += COST_TOFFOLI;
 		}
-		ofs << "cx add[0], frs[0];\n";
-		ofs << "cx add[1], frs[0];\n";
-		for (int i = 1; i <= last_bit; ++i) { // UMS
+		_cost += _config.getCostToffoli();
+	}
+	ofs << "cx add[0], frs[0];\n";
+	ofs << "cx add[1], frs[0];\n";
+	for (int i = 1; i <= last_bit; ++i) { // UMS
+		if (_is_lowered) {
+			ofs << "cx " << ands[i] << ", add[" << i << "];\n";
+			exportQasmUnand(ofs, "add[" + to_string(i + 1) + "]", "frs[" + to_string(i) + "]", ands[i]);
+			freeScratch(ands[i]);
+		}
+		else {
 			ofs << "ccx add[" << i + 1 << "], frs[" << i << "], add[" << i << "]; \n";
-			ofs << "cx add[" << i << "], add[" << i + 1 << "];\n";
-			ofs << "cx add[" << i + 1 << "], frs[" << i << "];\n";
 		}
+		ofs << "cx add[" << i << "], add[" << i + 1 << "];\n";
+		ofs << "cx add[" << i + 1 << "], frs[" << i << "];\n";
+	}
+}
+
+/* ===== Function Description:
+	Write a carry-lookahead adder adding "add[0..last_bit]" into "frs[0..last_bit]",
+	where the carries are stored in the "cla" register.
+*/
+void Optimizer::exportQasmWritePrefixAdder(ostream& ofs, int last_bit) {
+	int n_bits = last_bit + 1;
+	vector<NetGate> gates;
+	int n_ancilla = buildPrefixAdder(n_bits, gates);
+
+	vector<string> names(2 * n_bits + n_ancilla);	// bit j of the network is the (last_bit - j)-th column
+	for (int j = 0; j < n_bits; ++j) {
+		names[j] = "add[" + to_string(last_bit - j) + "]";
+		names[n_bits + j] = "frs[" + to_string(last_bit - j) + "]";
+	}
+	for (int k = 0; k < n_ancilla; ++k) {
+		names[2 * n_bits + k] = "cla[" + to_string(k) + "]";
+	}
+
+	vector<char> is_zero(names.size(), false);
+	fill(is_zero.begin() + 2 * n_bits, is_zero.end(), true);
+	for (NetGate& gate : gates) {
+		exportQasmNetGate(ofs, gate, names, gate.is_uncompute, is_zero);
+	}
+}
+
+/* ===== Function Description:
+	Get the entries of a table lookup: the bits of the sum of the angles of the gates selected by each address,
+	where the k-th gate is selected by the bit of weight 2^(#gates - 1 - k).
+	The last column with a bit in any entry is stored in 'last_bit' (-1 if the table is empty).
+*/
+vector<vector<int>> Optimizer::lookupTable(const Lookup& lookup, int& last_bit) {
+	int width = lookup.gate_ids.size();
+	vector<vector<int>> table(1LL << width, vector<int>(_r, 0));
+	last_bit = -1;
+	for (long long entry = 0; entry < table.size(); ++entry) {
+		long long carry = 0;
+		for (int i = _r - 1; i >= 0; --i) {
+			long long sum = carry;
+			for (int k = 0; k < width; ++k) {
+				if ((entry >> (width - 1 - k)) & 1) sum += lookup.digits[k][i];
+			}
+			table[entry][i] = sum & 1;
+			carry = (sum - table[entry][i]) / 2;		// the carry out of the MSB is a full turn
+			if (table[entry][i] == 1) last_bit = max(last_bit, i);
+		}
+	}
+	return table;
+}
+
+/* ===== Function Description:
+	Write the 'ith_lookup'-th table lookup: the entry addressed by the representative qubits of its gates is loaded into the "add" register,
+	added into the "frs" register, and unloaded.
+*/
+void Optimizer::exportQasmWriteLookup(ostream& ofs, int ith_lookup) {
+	int last_bit;
+	vector<vector<int>> table = lookupTable(_lookups[ith_lookup], last_bit);
+	if (last_bit == -1) return;
+
+	exportQasmIterateLookup(ofs, _lookups[ith_lookup], table, 0, "", 0);
+	if (_config.getAdderType() == ADDERTYPE::PREFIX)	exportQasmWritePrefixAdder(ofs, last_bit);
+	else												exportQasmWriteRippleAdder(ofs, last_bit);
+	exportQasmIterateLookup(ofs, _lookups[ith_lookup], table, 0, "", 0);	// unlookup
+}
+
+/* ===== Function Description:
+	Write the unary iteration [R. Babbush et al., 2018] over the address bits from the 'depth'-th one,
+	where 'flag' is 1 iff the higher address bits are the ones of 'entry' (the flag of depth k >= 2 is "lkp[k - 2]").
+	Each entry is loaded by CNOT gates controlled by its flag, and each flag is computed by a logical-AND gate,
+	whose sibling is obtained by a CNOT gate and whose uncomputation costs no T gate.
+*/
+void Optimizer::exportQasmIterateLookup(ostream& ofs, const Lookup& lookup, const vector<vector<int>>& table, int depth, const string& flag, int entry) {
+	if (depth == lookup.gate_ids.size()) {
+		for (int i = 0; i < _r; ++i) {
+			if (table[entry][i] == 1) ofs << "cx " << flag << ", add[" << i << "];\n";
+		}
+		return;
+	}
 
-		//ofs << "barrier;\n";
-		exportQasmSetAdderBits(ofs, ith_adder, true);	 // reverted
+	string control = _gate_list[lookup.gate_ids[depth]]->getName();
+	if (depth == 0) {	// the address bit itself is the flag
+		ofs << "x " << control << ";\n";
+		exportQasmIterateLookup(ofs, lookup, table, 1, control, 0);
+		ofs << "x " << control << ";\n";
+		exportQasmIterateLookup(ofs, lookup, table, 1, control, 1);
+		return;
 	}
+
+	string child = "lkp[" + to_string(depth - 1) + "]";
+	ofs << "x " << control << ";\n";
+	exportQasmAnd(ofs, flag, control, child);
+	ofs << "x " << control << ";\n";
+	_cost += _config.getCostToffoli();
+	exportQasmIterateLookup(ofs, lookup, table, depth + 1, child, entry * 2);
+	ofs << "cx " << flag << ", " << child << ";\n";
+	exportQasmIterateLookup(ofs, lookup, table, depth + 1, child, entry * 2 + 1);
+	exportQasmUnand(ofs, flag, control, child);
 }
 
 /* ===== Function Description:
 	Write excluded single rotation gates.
 */
-void Optimizer::exportQasmWriteSingle(ofstream& ofs) {
+void Optimizer::exportQasmWriteSingle(ostream& ofs) {
 	for (auto pair : _excluded) {
 		Gate* gate = _gate_list[pair.first];
-		float value = pair.second;
-		ofs << "rz(" << value << ") " << gate->getName() << ";\n";
-		_cost += _cost_single;
+		double value = pair.second;
+		ofs << "rz(" << setprecision(numeric_limits<double>::max_digits10) << value << setprecision(6) << ") " << gate->getName() << ";\n";
+		_cost += singleCost(pair.first);
 	}
 }
 
+/* ===== Function Description:
+	Write a logical-AND gate computing 'a' AND 'b' into 'target', which must be 0.
+	If the circuit is lowered, it is written by 4 T gates as in [C. Gidney, 2018]; otherwise, it is a Toffoli gate.
+*/
+void Optimizer::exportQasmAnd(ostream& ofs, const string& a, const string& b, const string& target) {
+	if (!_is_lowered) {
+		ofs << "ccx " << a << ", " << b << ", " << target << ";\n";
+		return;
+	}
+	ofs << "h " << target << ";\n";
+	ofs << "t " << target << ";\n";
+	ofs << "cx " << a << ", " << target << ";\n";
+	ofs << "cx " << b << ", " << target << ";\n";
+	ofs << "cx " << target << ", " << a << ";\n";
+	ofs << "cx " << target << ", " << b << ";\n";
+	ofs << "tdg " << a << ";\n";
+	ofs << "tdg " << b << ";\n";
+	ofs << "t " << target << ";\n";
+	ofs << "cx " << target << ", " << a << ";\n";
+	ofs << "cx " << target << ", " << b << ";\n";
+	ofs << "h " << target << ";\n";
+	ofs << "s " << target << ";\n";
+}
 
 /* ===== Function Description:
-	Write the optimized circuit in openQASM format.
+	Uncompute a logical-AND gate, i.e., reset 'target', which must be 'a' AND 'b', to 0.
+	If the circuit is lowered, 'target' is measured in the X basis into the "unc" register,
+	and the phase is fixed by a CZ gate if the result is 1, which costs no T gate; otherwise, it is a Toffoli gate.
 */
-float Optimizer::exportQasm(const string& file_name) {
-	int n_ancilla = 0;
-	for (Gate* gate : _gate_list) {
-		if (gate->getTypeStr() == "rxx" || gate->getTypeStr() == "ryy" || gate->getTypeStr() == "rzz" || gate->getTypeStr() == "cp") {
-			n_ancilla++;
+void Optimizer::exportQasmUnand(ostream& ofs, const string& a, const string& b, const string& target) {
+	if (!_is_lowered) {
+		ofs << "ccx " << a << ", " << b << ", " << target << ";\n";
+		return;
+	}
+	ofs << "h " << target << ";\n";
+	ofs << "measure " << target << " -> unc[0];\n";
+	ofs << "if(unc==1) cz " << a << ", " << b << ";\n";
+	ofs << "if(unc==1) x " << target << ";\n";
+}
+
+/* ===== Function Description:
+	Write a multi-controlled NOT gate on any 'target'.
+	If the circuit is lowered, the product of the controls is computed by a chain of logical-AND gates in the "tmp" register,
+	copied into 'target', and uncomputed, i.e., 4 T gates per control after the first one.
+*/
+void Optimizer::exportQasmToffoli(ostream& ofs, const vector<string>& controls, const string& target) {
+	if (!_is_lowered || controls.size() == 1) {
+		if (controls.size() == 1)		ofs << "cx ";
+		else if (controls.size() == 2)	ofs << "ccx ";
+		else 							ofs << "mcx ";
+		for (const string& control : controls) ofs << control << ", ";
+		ofs << target << ";\n";
+		return;
+	}
+
+	vector<string> ands;
+	string product = controls[0];
+	for (int j = 1; j < controls.size(); ++j) {
+		ands.emplace_back(allocateScratch());
+		exportQasmAnd(ofs, product, controls[j], ands.back());
+		product = ands.back();
+	}
+	ofs << "cx " << product << ", " << target << ";\n";
+	for (int j = controls.size() - 1; j >= 1; --j) {
+		exportQasmUnand(ofs, (j == 1) ? controls[0] : ands[j - 2], controls[j], ands[j - 1]);
+		freeScratch(ands[j - 1]);
+	}
+}
+
+/* ===== Function Description:
+	Write a gate of a reversible network (see 'buildPrefixAdder') with the wires named by 'names'.
+	A Toffoli gate is a logical-AND gate if its target is 0 ('is_zero', which is updated),
+	the uncomputation of one if 'is_uncompute' is true, and a lowered Toffoli gate on any target otherwise.
+*/
+void Optimizer::exportQasmNetGate(ostream& ofs, const NetGate& gate, const vector<string>& names, bool is_uncompute, vector<char>& is_zero) {
+	const vector<int>& wires = gate.wires;
+	int target = wires.back();
+	if (wires.size() == 3) {
+		if (is_uncompute)			exportQasmUnand(ofs, names[wires[0]], names[wires[1]], names[target]);
+		else if (is_zero[target])	exportQasmAnd(ofs, names[wires[0]], names[wires[1]], names[target]);
+		else						exportQasmToffoli(ofs, { names[wires[0]], names[wires[1]] }, names[target]);
+		if (!is_uncompute) _cost += _config.getCostToffoli();
+	}
+	else {
+		ofs << ((wires.size() == 1) ? "x " : "cx ");
+		for (int i = 0; i < wires.size(); ++i) {
+			ofs << names[wires[i]] << ((i + 1 < wires.size()) ? ", " : ";\n");
 		}
 	}
-	// use another ancilla qubit to represent the two-qubit gate
+	is_zero[target] = (wires.size() == 3 && is_uncompute);
+}
+
+/* ===== Function Description:
+	Allocate a qubit of the "tmp" register, and return its name.
+*/
+string Optimizer::allocateScratch() {
+	int index = _n_scratch;
+	if (_free_scratch.empty()) {
+		_n_scratch++;
+	}
+	else {
+		index = *_free_scratch.begin();
+		_free_scratch.erase(_free_scratch.begin());
+	}
+	return "tmp[" + to_string(index) + "]";
+}
+
+/* ===== Function Description:
+	Free a qubit of the "tmp" register, which must be 0.
+*/
+void Optimizer::freeScratch(const string& name) {
+	_free_scratch.insert(stoi(name.substr(4)));
+}
+
+
+/* ===== Function Description:
+	Count the ancilla qubits representing two-qubit gates, i.e., the peak number of live ones.
+*/
+int Optimizer::countAncilla() {
+	concrete();
+	return _n_ancilla;
+}
+
+/* ===== Function Description:
+	Count the ancilla qubits storing the carries of carry-lookahead adders.
+*/
+int Optimizer::countCarryAncilla() {
+	if (_config.getAdderType() != ADDERTYPE::PREFIX) return 0;
+	vector<NetGate> gates;
+	return buildPrefixAdder(_r, gates);
+}
+
+/* ===== Function Description:
+	Count the ancilla qubits storing the flags of the unary iterations of table lookups.
+*/
+int Optimizer::countLookupAncilla() {
+	int n_ancilla = 0;
+	for (Lookup& lookup : _lookups) {
+		n_ancilla = max(n_ancilla, (int)lookup.gate_ids.size() - 1);
+	}
+	return n_ancilla;
+}
 
+/* ===== Function Description:
+	Count the ancilla qubits of the Hamming-weight phasing of the special case.
+*/
+int Optimizer::countHammingAncilla() {
+	if (!_is_hamming) return 0;
+	vector<NetGate> gates;
+	vector<int> weights;
+	int last_bit;
+	return buildHamming(gates, weights, last_bit);
+}
+
+/* ===== Function Description:
+	Write the notice comments of the synthesized circuit.
+*/
+void Optimizer::exportQasmNotice(ostream& ofs, bool is_same, bool is_lowered) {
+	if (is_lowered) {
+		ofs << "// Notice: The Toffoli gates are lowered into Clifford+T gates by the logical-AND gates in [C. Gidney, 2018],\n";
+		ofs << "//           whose uncomputations are measurements into \"unc\".\n";
+		ofs << "//         The single rotation gates are not lowered.\n";
+		if (is_same) ofs << "//         The cost of reverse Fourier state transform is not counted;\n";
+		ofs << endl;
+		return;
+	}
+	ofs << "// Notice: All Toffoli gates are recovered after the circuit,.\n";
+	ofs << "//           and the method in [C. Gidney, 2018] can be applied.\n";
+	ofs << "//         We use the method to calculate the T-count,\n";
+	ofs << "//           but we keep the original circuit for clearity.\n";
+	ofs << "//         The products of the counters are stored on \"anc\" qubits and shared by the counter bits.\n";
+	if (is_same) ofs << "//         The cost of reverse Fourier state transform is not counted;\n";
+	ofs << endl;
+}
+
+/* ===== Function Description:
+	Write the optimized circuit in openQASM format.
+*/
+float Optimizer::exportQasm(const string& file_name) {
 	ofstream ofs;
 	ofs.open(file_name);
 	for (string& line : _headers) {
 		ofs << line << endl;
 	}
-	ofs << "qreg anc[" << n_ancilla << "];\n";
+	ofs << "qreg anc[" << countAncilla() << "];\n";
 	ofs << "qreg add[" << _r + 1 << "];\n";
 	ofs << "qreg frs[" << _r << "];\n";
-	ofs << "// Notice: All Toffoli gates are recovered after the circuit,.\n";
-	ofs << "//           and the method in [C. Gidney, 2018] can be applied.\n";
-	ofs << "//         We use the method to calculate the T-count,\n";
-	ofs << "//           but we keep the original circuit for clearity.\n";
-	ofs << "//         Also, counter circuits can be easily simplified,\n";
-	ofs << "//           but we keep the original circuit for clearity.\n";
-	if (_is_same) ofs << "//         The cost of reverse Fourier state transform is not counted;\n";
-	ofs << endl;
+	if (countCarryAncilla() > 0) ofs << "qreg cla[" << countCarryAncilla() << "];\n";
+	if (countLookupAncilla() > 0) ofs << "qreg lkp[" << countLookupAncilla() << "];\n";
+	if (countHammingAncilla() > 0) ofs << "qreg hw[" << countHammingAncilla() << "];\n";
+	exportQasmNotice(ofs, _config.isSame());
 
-	if (_is_same) exportQasmFourierTrans(ofs, false);
+	return exportQasmBody(ofs);
+}
+
+/* ===== Function Description:
+	Write the gates of the optimized circuit (without register declarations).
+	The "anc", "add", and "frs" registers (and the "cla", "lkp", and "hw" ones if used) are assumed to be declared,
+	and so are the "tmp" register (see 'countScratchAncilla') and the "unc" 1-bit classical register if the circuit is lowered.
+	If 'with_fourier' is false, the Fourier-state transformation of the special case is left to the caller.
+*/
+float Optimizer::exportQasmBody(ostream& ofs, bool with_fourier) {
+	if (_config.isSame() && with_fourier) exportQasmFourierTrans(ofs, false);
+	_free_scratch.clear();
+	_n_scratch = 0;
 
+	concrete();
 	exportQasmRotTypeTrans(ofs, false);			// rotation type transformation
-	exportQasmSetAnc(ofs, false);				// set representative ancilla qubits for two-qubit gates
-	exportQasmWriteAdder(ofs);
-	exportQasmSetAnc(ofs, true);				
+	int n_rows = _n_rows + _lookups.size();
+	for (int row = 0; row <= n_rows; ++row) {
+		exportQasmSetAnc(ofs, row, false);		// set representative ancilla qubits for two-qubit gates
+		exportQasmSetProducts(ofs, row, false);	// compute the products of the counters
+		if (row < _n_rows)		exportQasmWriteAdder(ofs, row);
+		else if (row < n_rows)	exportQasmWriteLookup(ofs, row - _n_rows);
+		else					exportQasmWriteSingle(ofs);
+		exportQasmSetProducts(ofs, row, true);
+		exportQasmSetAnc(ofs, row, true);
+	}
 	exportQasmRotTypeTrans(ofs, true);
-	exportQasmWriteSingle(ofs);
 
-	if (_is_same) exportQasmFourierTrans(ofs, true);
+	if (_config.isSame() && with_fourier) exportQasmFourierTrans(ofs, true);
 
 	return _cost;
 }
 
+/* ===== Function Description:
+	Calculate the statistics of the synthesized circuit without writing any gates.
+	The T-count is exactly the one returned by 'exportQasm'.
+	The T-depth assumes that the adders and the counter gates are applied one by one,
+	while gates on different qubits in the other parts are applied in parallel.
+*/
+Estimate Optimizer::estimate() {
+	concrete();
+
+	Estimate est;
+	est.n_ancilla = countAncilla();
+	est.add_width = _r + 1;
+	est.frs_width = _r;
+	est.cla_width = countCarryAncilla();
+	est.lkp_width = countLookupAncilla();
+	est.hw_width = countHammingAncilla();
+	est.counter_cost = _counter_cost;
+	est.hamming_cost = _hamming_cost;
+	est.model_cost = _optimized_cost;
+	est.lower_bound = _lower_bound;
+	CostModel cost_model(_config);
+
+	if (_config.isSame()) {
+		est.fourier_cost = _config.getCostSingle() * _r;
+		est.fourier_depth = _config.getCostSingle();
+		est.t_count += est.fourier_cost;
+		est.t_depth += est.fourier_depth;
+	}
+
+	int n_rows = _n_rows + _lookups.size();
+	for (int row = 0; row <= n_rows; ++row) {
+		// representative ancilla qubits computed before the row
+		map<int, int> n_cp_gates;		// qubit -> #"cp" gates on it
+		int max_cp_gates = 0;
+		for (int gate_id : _anc_computed[row]) {
+			Gate* gate = _gate_list[gate_id];
+			if (gate->getTypeStr() == "cp") {
+				est.t_count += _config.getCostToffoli();
+				max_cp_gates = max(max_cp_gates, ++n_cp_gates[gate->getQubit(0)]);
+				max_cp_gates = max(max_cp_gates, ++n_cp_gates[gate->getQubit(1)]);
+			}
+		}
+		est.t_depth += max_cp_gates * _config.getDepthToffoli();
+		if (row == n_rows) break;
+
+		// products of the counters computed before the row
+		est.t_count += _products_computed[row].size() * _config.getCostToffoli();
+		est.t_depth += _products_computed[row].size() * _config.getDepthToffoli();
+
+		// Hamming-weight phasing
+		if (_is_hamming) {
+			vector<NetGate> gates;
+			vector<int> weights;
+			int last_bit;
+			int n_wires = _n + buildHamming(gates, weights, last_bit);
+			int n_toffoli, toffoli_depth;
+			countNetworkToffoli(gates, n_wires, n_toffoli, toffoli_depth);
+			est.t_count += n_toffoli * _config.getCostToffoli();
+			est.t_depth += toffoli_depth * _config.getDepthToffoli();
+			if (last_bit != -1) {
+				est.t_count += cost_model.adderCost(last_bit);
+				est.t_depth += cost_model.adderDepth(last_bit);
+			}
+			continue;
+		}
+
+		// table lookups
+		if (row >= _n_rows) {
+			const Lookup& lookup = _lookups[row - _n_rows];
+			int last_bit;
+			lookupTable(lookup, last_bit);
+			if (last_bit == -1) continue;
+			est.t_count += cost_model.lookupCost(lookup.gate_ids.size()) + cost_model.adderCost(last_bit);
+			est.t_depth += cost_model.lookupDepth(lookup.gate_ids.size()) + cost_model.adderDepth(last_bit);
+			continue;
+		}
+
+		// adders
+		int last_bit = -1;
+		for (int i = 0; i < _r; ++i) {
+			if (_bit_table[i].size() > row) last_bit = i;
+		}
+		est.t_count += cost_model.adderCost(last_bit);
+		est.t_depth += cost_model.adderDepth(last_bit);
+	}
+
+	// single rotation gates
+	map<string, float> single_depths;	// qubit name -> T-depth of the single rotation gates on it
+	float max_single_depth = 0;
+	for (auto item : _excluded) {
+		est.t_count += singleCost(item.first);
+		est.single_cost += singleCost(item.first);
+		max_single_depth = max(max_single_depth, single_depths[_gate_list[item.first]->getName()] += singleCost(item.first));
+	}
+	est.t_depth += max_single_depth;
+	return est;
+}
+
 /* ===== Function Description:
 	Print current status.
 */
@@ -461,6 +1622,14 @@ void Optimizer::printInfo(const string& header) {
 	if (_excluded.empty()) cout << "(empty)";
 	cout << endl;
 
+	cout << "  lookups: ";
+	for (Lookup& lookup : _lookups) {
+		cout << endl << "    IDs";
+		for (int gate_id : lookup.gate_ids) cout << " " << gate_id;
+	}
+	if (_lookups.empty()) cout << "(empty)";
+	cout << endl;
+
 	cout << "  bitTable: " << endl;
 	cout << "    MSB" << endl;
 	for (int i = 0; i < _r; i++) {
@@ -1,12 +1,11 @@
 #include <boost/program_options.hpp>
 #include "headers.h"
 
-float getCostSingle(int precision) {
-  	float HST = 3.0 * (precision + 1) + log2(precision + 1);
-  	float RUS = 1.149 * (precision + 1) + 9.2;
-  	float PQF = 1.0 * (precision + 1) + 4 * log2(precision + 1) + 1.187;
-  	float cost_single = min(HST, min(RUS, PQF));
-  	return cost_single;
+void printGap(const Estimate& est, bool is_same) {
+  	float gap = (est.model_cost > 0) ? 100 * (est.model_cost - est.lower_bound) / est.model_cost : 0;
+  	cout << "Optimizer cost = " << est.model_cost << " (lower bound = " << est.lower_bound << ", gap = " << fixed << setprecision(2) << gap << "%)" << defaultfloat << setprecision(6) << endl;
+  	if (est.hamming_cost > 0 && is_same) cout << "Same-angle engines: counters = " << est.counter_cost << ", Hamming-weight phasing = " << est.hamming_cost << endl;
+  	if (est.hamming_cost > 0 && !is_same) cout << "Engines: adder rows = " << est.counter_cost << ", carry-save compressor = " << est.hamming_cost << endl;
 }
 
 int main(int argc, char** argv) {
@@ -17,30 +16,181 @@ int main(int argc, char** argv) {
         ("in",  po::value<string>(), "qasm file string for synthesis")
         ("out", po::value<string>(), "qasm file string after synthesis")
         ("prec", po::value<unsigned int>()->default_value(30), "precision in bits (default: 30)")
-        ("cost", po::value<double>()->default_value(1000), "T-count of applying an independent single-gate rotation. Set it to a large number to disable applying single-gate rotations (default: 1000)")
+        ("cost", po::value<string>()->default_value("1000"), "T-count of applying an independent single-gate rotation. Set it to a large number to disable applying single-gate rotations, or to \"model\" to estimate it from the precision of each gate, rounded up to whole T gates (default: 1000)")
+        ("toffoli", po::value<double>()->default_value(4), "T-count of a Toffoli gate (default: 4)")
+        ("budget", po::value<double>(), "distribute a total rounding error over the rotation gates without error annotations (\"// error=<value>\" after a gate), lowering their precisions to reduce the T-count")
+        ("lookup", po::value<unsigned int>()->implicit_value(4), "also add windows of up to N rotation gates by table lookups (unary iteration over their qubits, loading the sums of their angles for one adder) where it is cheaper than the adder rows (default N: 4)")
+        ("open-blocks", po::value<unsigned int>()->implicit_value(3), "keep up to N blocks open while parsing, so that each rotation gate joins the earliest block it commutes with and circuits mixing rotation axes on a qubit are not cut into a block at every change of the axis (default N: 3)")
         ("same", "use Fourier state transformation for the same-angle special case")
+        ("phasing", po::value<string>()->default_value("auto"), "engine of the adder rows: \"counter\" (the optimized bit table with an adder per row), \"hamming\" (compressing all bits into one row by a tree of full and half adders for one adder: Hamming-weight phasing under --same, a carry-save compressor otherwise), or \"auto\" (the cheaper one) (default: auto)")
+        ("recode", "also optimize each block from a bit table whose signed-digit forms of the angles are chosen jointly to flatten its heights, instead of the Booth encoding of each angle alone, and keep the cheaper result (not with --same)")
+        ("threads", po::value<unsigned int>()->default_value(0), "number of threads for synthesizing independent blocks (default: 0, all hardware threads)")
+        ("adder", po::value<string>()->default_value("ripple"), "adder circuit: \"ripple\" (ripple-carry, linear T-depth) or \"prefix\" (carry-lookahead, logarithmic T-depth and more T gates) (default: ripple)")
+        ("exact", po::value<unsigned long long>()->implicit_value(100000), "synthesize each block by branch-and-bound from the greedy result, exploring at most N nodes (default N: 100000)")
+        ("verify", po::value<unsigned int>()->implicit_value(65536), "check each block of the written circuit against the exact angles of its gates by bit-parallel simulation on N computational-basis inputs, or all inputs if there are fewer, including its basis changes (h, s, sdg) on the data qubits (with --lower or --synth, the distinct blocks are checked before lowering and synthesis) (default N: 65536)")
+        ("lower", "write the Toffoli gates in Clifford+T by logical-AND gates and measurement-based uncomputation, and check the T-count of the written gates against the modeled one (--verify checks the circuit before lowering)")
+        ("synth", "write the single rotations and the Fourier-state transformations in Clifford+T by number-theoretic synthesis within 2^-(prec+1) each, and count their T gates instead of the modeled cost (--prec is at most 36)")
+        ("binary", "write the synthesized circuit in the binary circuit format (an input in the binary formats is detected automatically)")
+        ("convert", "only convert --in between openQASM and the binary formats (or an angle matrix between CSV and binary) into --out without synthesis")
+        ("sweep", po::value<string>(), "synthesize --in for each row of an angle matrix (CSV or binary), giving the angles of all rotation gates in input order, and print a T-count table (a block with a changed rounded angle is synthesized again as a whole); the circuit of row k is written to --out with \"_k\" appended to the stem if --out is given")
+        ("plan", po::value<string>(), "write the synthesis plan into a binary file, which can be given as --in to write the circuit again without optimizing (e.g., with another --adder or --binary); the precision, --same, and --cost are taken from the plan")
+        ("checkpoint", po::value<double>()->implicit_value(60), "also write the plan every N seconds while synthesizing, so that an interrupted run can be resumed by giving the plan as --in (default N: 60)")
+        ("schedule", po::value<string>()->implicit_value(""), "schedule the written circuit into ASAP layers, where gates on different qubits (or acting on a shared qubit by the same Pauli type, e.g., CNOT gates with the same control) may be reordered, and print the depth, the number of layers with T gates, and the widths of the layers; the width and the number of T gates of each layer are written into the given CSV file (needs --lower)")
+        ("layers", "with --schedule, rewrite the written circuit layer by layer, separated by barriers")
+        ("estimate", "only calculate the T-count, T-depth, and register sizes without writing the circuit (--out is not needed)")
     ;
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, description), vm);
     po::notify(vm);
     
-    if (vm.count("help") || !vm.count("in") || !vm.count("out")) {
+    bool is_estimate = (bool)vm.count("estimate");
+    if (vm.count("help") || !vm.count("in") || (!vm.count("out") && !is_estimate && !vm.count("sweep"))) {
   	    std::cout << description << std::endl;
   	    return 1;
 	  }
+    if ((vm.count("schedule") || vm.count("layers")) && (!vm.count("schedule") || !vm.count("lower") || is_estimate || vm.count("sweep") || vm.count("binary") || vm.count("convert"))) {
+      cerr << "[Error]: --schedule needs a synthesized openQASM circuit lowered by --lower, and --layers needs --schedule." << endl;
+      return 1;
+    }
     
     string in_cir  = vm["in"].as<string>();
-    string out_cir = vm["out"].as<string>();
+    if (vm.count("convert")) {
+      string message;
+      if (!vm.count("out") || !convertCircuit(in_cir, vm["out"].as<string>(), message)) {
+        cerr << "[Error]: Conversion failed: " << (vm.count("out") ? message : "--out is needed") << "." << endl;
+        return 1;
+      }
+      return 0;
+    }
+
     int prec = vm["prec"].as<unsigned int>();
-    int cost = vm["cost"].as<double>();
+    string cost_str = vm["cost"].as<string>();
+    float cost;
+    try { cost = (cost_str == "model") ? -1 : stof(cost_str); }		// a negative cost selects 'countSingleCost'
+    catch (...) {
+      std::cout << description << std::endl;
+      return 1;
+    }
     bool is_same = (bool)vm.count("same");
+    int n_threads = vm["threads"].as<unsigned int>();
+    string adder = vm["adder"].as<string>();
+    if (adder != "ripple" && adder != "prefix") {
+      std::cout << description << std::endl;
+      return 1;
+    }
+    ADDERTYPE adder_type = (adder == "prefix") ? ADDERTYPE::PREFIX : ADDERTYPE::RIPPLE;
+    string phasing = vm["phasing"].as<string>();
+    if (phasing != "auto" && phasing != "counter" && phasing != "hamming") {
+      std::cout << description << std::endl;
+      return 1;
+    }
+    PHASINGTYPE phasing_type = (phasing == "counter") ? PHASINGTYPE::COUNTER : (phasing == "hamming") ? PHASINGTYPE::HAMMING : PHASINGTYPE::AUTO;
+
+    int lookup_width = vm.count("lookup") ? vm["lookup"].as<unsigned int>() : 0;
+    if (lookup_width > 16) {
+      cerr << "[Error]: The lookup width is at most 16." << endl;
+      return 1;
+    }
+    if (vm.count("recode") && is_same) {
+      cerr << "[Error]: --recode cannot be used with --same." << endl;
+      return 1;
+    }
+    Config config(prec, cost, is_same, adder_type, vm["toffoli"].as<double>(), Config().getDepthToffoli(), lookup_width, phasing_type);
+    Frontend fe(config, n_threads);
+    if (vm.count("lower")) {
+      if (config.getCostToffoli() != 4) {
+        cerr << "[Error]: --lower writes 4 T gates per Toffoli gate, so --toffoli must be 4." << endl;
+        return 1;
+      }
+      fe.setLowered(true);
+    }
+    if (vm.count("synth")) {
+      if (is_estimate || vm.count("sweep") || prec > MAX_SYNTHESIS_PRECISION) {
+        cerr << "[Error]: --synth needs a written circuit and a precision of at most " << MAX_SYNTHESIS_PRECISION << " bits." << endl;
+        return 1;
+      }
+      fe.setSynthesized(true);
+    }
+    if (vm.count("recode")) fe.setRecoded(true);
+    if (vm.count("open-blocks")) fe.setMaxLayers(vm["open-blocks"].as<unsigned int>());
+    if (vm.count("exact")) fe.setExact(vm["exact"].as<unsigned long long>());
+    if (vm.count("checkpoint")) {
+      if (!vm.count("plan")) {
+        cerr << "[Error]: --checkpoint needs --plan." << endl;
+        return 1;
+      }
+      fe.setCheckpoint(vm["plan"].as<string>(), vm["checkpoint"].as<double>());
+    }
+		if (isBinaryFile(in_cir))	fe.importBinary(in_cir);
+		else						fe.importQasm(in_cir);
+		if (vm.count("budget")) {
+			if (is_same) {
+				cerr << "[Error]: --budget cannot be used with --same." << endl;
+				return 1;
+			}
+			double budget = vm["budget"].as<double>();
+			double error = fe.allocateErrorBudget(budget);
+			cout << "Rounding error = " << error << " (budget = " << budget << ")" << endl;
+			if (error > budget) cerr << "[Warning]: The rounding error at the precision of " << prec << " bits exceeds the budget." << endl;
+		}
+		if (vm.count("sweep")) {
+			vector<vector<Angle>> points;
+			string message;
+			if (!readAngleMatrix(vm["sweep"].as<string>(), points, message)) {
+				cerr << "[Error]: Cannot read the angle matrix: " << message << "." << endl;
+				return 1;
+			}
+			vector<int> n_blocks;
+			string out_cir = (vm.count("out") && !is_estimate) ? vm["out"].as<string>() : "";
+			vector<Estimate> ests = fe.sweep(points, out_cir, (bool)vm.count("binary"), n_blocks);
+			cout << "point,t_count,t_depth,n_ancilla,distinct_blocks" << endl;
+			for (int k = 0; k < ests.size(); ++k) {
+				cout << k << "," << ests[k].t_count << "," << ests[k].t_depth << "," << ests[k].n_ancilla << "," << n_blocks[k] << endl;
+			}
+			return 0;
+		}
+		if (is_estimate) {
+			Estimate est = fe.estimate();
+			cout << "Estimated " << fe.getNumBlocks() << " distinct block(s) out of " << fe.getNumLayers() << " rotation block(s)." << endl;
+			cout << "Final T-count = " << est.t_count << endl;
+			cout << "Final T-depth = " << est.t_depth << endl;
+			cout << "Peak ancilla usage = " << est.n_ancilla << endl;
+			cout << "Register sizes: anc = " << est.n_ancilla << ", add = " << est.add_width << ", frs = " << est.frs_width;
+			if (est.cla_width > 0) cout << ", cla = " << est.cla_width;
+			if (est.lkp_width > 0) cout << ", lkp = " << est.lkp_width;
+			if (est.hw_width > 0) cout << ", hw = " << est.hw_width;
+			cout << endl;
+			if (!fe.isPlanImported()) printGap(est, is_same);
+			if (vm.count("plan")) fe.writePlan(vm["plan"].as<string>());
+			return 0;
+		}
 
-    Optimizer op(prec, cost, is_same);
-		op.importQasm(in_cir);
-		op.optimize();
-		op.concrete();
-		float t_count = op.exportQasm(out_cir);
+		string out_cir = vm["out"].as<string>();
+		float t_count = fe.exportQasm(out_cir, (bool)vm.count("binary"));
+		cout << "Synthesized " << fe.getNumBlocks() << " distinct block(s) out of " << fe.getNumLayers() << " rotation block(s)." << endl;
 		cout << "Finished. Final T-count = " << t_count << endl;
+		cout << "Final T-depth = " << fe.getEstimate().t_depth << endl;
+		cout << "Peak ancilla usage = " << fe.getEstimate().n_ancilla << endl;
+		if (!fe.isPlanImported()) printGap(fe.getEstimate(), is_same);
+		if (vm.count("synth")) fe.printSynthesized();
+		if (vm.count("schedule")) {
+			Scheduler scheduler;
+			string message;
+			if (!scheduleCircuit(out_cir, vm["schedule"].as<string>(), (bool)vm.count("layers"), scheduler, message)) {
+				cerr << "[Error]: Scheduling failed: " << message << "." << endl;
+				return 1;
+			}
+			int max_width = scheduler.widths.empty() ? 0 : *max_element(scheduler.widths.begin(), scheduler.widths.end());
+			float mean_width = (scheduler.depth > 0) ? (float)accumulate(scheduler.widths.begin(), scheduler.widths.end(), 0LL) / scheduler.depth : 0;
+			cout << "Scheduled depth = " << scheduler.depth << ", layers with T gates = " << scheduler.n_t_layers << ", layer width: max = " << max_width << ", mean = " << mean_width << endl;
+		}
+		if (vm.count("plan")) fe.writePlan(vm["plan"].as<string>());
+		if (vm.count("verify") && !fe.verify(out_cir, (bool)vm.count("binary"), vm["verify"].as<unsigned int>())) {
+			return 2;
+		}
+		if (vm.count("lower") && !fe.checkLowered()) {
+			return 3;
+		}
     
 	  return 0;
 }
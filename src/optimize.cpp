@@ -3,7 +3,7 @@
 /* ===== Function Description:
 	Constructor of the 'Optimizer' class.
 */
-Optimizer::Optimizer(int precision, float cost_single, bool is_same) : _r(precision), _is_same(is_same), _cost_single(cost_single) {
+Optimizer::Optimizer(const Config& config) : _config(config), _r(config.getPrecision()) {
 	_heights		= vector<int>(_r, 0);
 	_n_carry		= vector<int>(_r, 0);
 	_n_counter		= vector<int>(_r, 0);
@@ -30,19 +30,19 @@ void Optimizer::updatePeaks(vector<int>& peaks) {
 
 /* ===== Function Description:	
 	Main synthesis process.
+	With a checkpoint, the state between the iterations is saved periodically, and a saved state can be resumed by 'readPlan'.
 */
 pair<float, int> Optimizer::optimize(bool to_print_info) {
-	float total_cost = 0;
-	int n_adder = 0;
-	for (Gate* gate : _gate_list) {
-		if (gate->getTypeStr() == "cp") {
-			total_cost += COST_TOFFOLI;
-		}
-	}
-	if (_is_same) total_cost += _cost_single * _r;
+	float total_cost = startCost();
+	if (!_is_resumed) _lower_bound = total_cost + remainingBound();		// otherwise, the bound of the checkpoint is kept
+	bool is_compressible = !_config.isSame() && _config.getPhasingType() != PHASINGTYPE::COUNTER && !_is_resumed && !_is_lookup_trial;
+	vector<vector<Bit>> compressed_table;		// of the carry-save compressor, taken before any move
+	if (is_compressible) compressed_table = compressorTable();
+	if (_config.getLookupWidth() > 0 && !_is_resumed && !_is_lookup_trial) total_cost += planLookups();
 
 	vector<int> peaks, remaining;
 	for (int ith_iter = 0; ; ++ith_iter) {
+		checkpoint(total_cost);
 		if (to_print_info) 
 			printInfo("iteration " + to_string(ith_iter) + " (current cost = " + to_string(total_cost) + "):");
 		
@@ -82,11 +82,20 @@ pair<float, int> Optimizer::optimize(bool to_print_info) {
 		vector<int> new_n_carry_counter = _n_carry;
 		vector<int> new_n_counter_counter = _n_counter;
 		vector<vector<int>> new_counter_sizes_counter = _counter_sizes;
-		int cost_counter = doCounter(new_heights_counter, new_n_carry_counter, new_n_counter_counter, new_counter_sizes_counter, remaining, dealing_remaining_index);
+		float cost_counter = doCounter(new_heights_counter, new_n_carry_counter, new_n_counter_counter, new_counter_sizes_counter, remaining, dealing_remaining_index);
 		
 		// method 3 : single-gate
 		unordered_set<int> new_excluded_single;
-		int cost_single = doSingle(new_excluded_single, remaining);
+		float cost_single = doSingle(new_excluded_single, remaining);
+
+		// method 4 : table lookup, compared by its cost per level
+		vector<int> new_lookup;
+		int n_levels;
+		float cost_lookup = doLookup(new_lookup, remaining, n_levels);
+		if (cost_lookup != COST_INF && cost_lookup < min(cost_counter, cost_single) * n_levels) {
+			total_cost += cost_lookup + lookupGates(new_lookup);
+			continue;
+		}
 
 		if (cost_counter <= cost_single) {
 			total_cost += cost_counter;
@@ -96,35 +105,365 @@ pair<float, int> Optimizer::optimize(bool to_print_info) {
 			_counter_sizes = new_counter_sizes_counter;
 
 			if (dealing_remaining_index < remaining.size()) {  // new adder is used
-				total_cost -= countAdderCost(remaining[dealing_remaining_index]);	// avoid counting twice
+				total_cost -= _cost_model.adderCost(remaining[dealing_remaining_index]);	// avoid counting twice
 				//if (to_print_info) { cout << "[system pause] >> "; string temp; cin >> temp; cout << endl; }
 				break;
 			}
 		}
 		else {
-			total_cost += cost_single;
-			for (int i = 0; i < _r; i++) {
-				for (Bit& bit : _bit_table[i]) {
-					if (new_excluded_single.count(bit.getGateId()) > 0 && _heights[i] > 0) {
-						bit.setInactivate();
-						_excluded[bit.getGateId()] += pow(2, (-1 - i)) * 2 * M_PI;
-						_heights[i]--;
-					}
-				}
-			}
-			removeExcluded();
+			total_cost += cost_single + excludeGates(new_excluded_single);
 		}
 		//if (to_print_info) { cout << "[system pause] >> "; string temp; cin >> temp; cout << endl; }
 	}
 
 	// calculate the remaining cost of adders
+	int n_adder = 0;
+	total_cost += closeCost(n_adder);
+
+	// the special case may be cheaper by Hamming-weight phasing
+	if (_config.isSame() && _config.getPhasingType() != PHASINGTYPE::COUNTER && !_is_lookup_trial) {
+		_counter_cost = total_cost;
+		_hamming_cost = hammingCost();
+		if (_config.getPhasingType() == PHASINGTYPE::HAMMING || _hamming_cost < _counter_cost) {
+			useHamming();
+			total_cost = _hamming_cost;
+			n_adder = 1;
+		}
+	}
+
+	// the adder rows may be cheaper by a carry-save compressor
+	if (is_compressible) {
+		Optimizer trial = *this;
+		trial._save_plan = nullptr;
+		trial.useHamming(compressed_table);
+		_counter_cost = total_cost;
+		_hamming_cost = trial.hammingCost();
+		if (_config.getPhasingType() == PHASINGTYPE::HAMMING || _hamming_cost < _counter_cost) {
+			useHamming(compressed_table);
+			total_cost = _hamming_cost;
+			n_adder = 1;
+		}
+	}
+	_optimized_cost = total_cost;
+	_is_optimized = true;
+	_is_resumed = false;
+	return make_pair(total_cost, n_adder);
+}
+
+/* ===== Function Description:
+	Set up the cost model, and get the cost paid before the first move:
+	the fixed cost, or the cost paid so far if the state is resumed from a checkpoint.
+*/
+float Optimizer::startCost() {
+	if (!_is_resumed) _max_counter_size = *max_element(_heights.begin(), _heights.end());
+	_cost_model = CostModel(_config, _max_counter_size);
+	return _is_resumed ? _optimized_cost : fixedCost();
+}
+
+void Optimizer::setCheckpoint(const function<void(const string&)>& save_plan, double interval) {
+	_save_plan = save_plan;
+	_checkpoint_interval = interval;
+	_last_checkpoint = chrono::steady_clock::now();
+}
+
+/* ===== Function Description:
+	Save the state with the cost paid so far if the checkpoint interval has passed since the last one.
+*/
+void Optimizer::checkpoint(float total_cost) {
+	if (!_save_plan || chrono::duration<double>(chrono::steady_clock::now() - _last_checkpoint).count() < _checkpoint_interval) return;
+	_optimized_cost = total_cost;
+	_save_plan(writePlan());
+	_last_checkpoint = chrono::steady_clock::now();
+}
+
+/* ===== Function Description:
+	Get the cost paid by every method: the "cp" gates and, in the special case, the Fourier-state transformation.
+	A "cp" gate whose angle is 0 at the precision has no bits, and its representative ancilla is not computed (see 'allocateAncilla').
+*/
+float Optimizer::fixedCost() {
+	vector<bool> is_used(_n, false);
+	for (int i = 0; i < _r; ++i) {
+		for (const Bit& bit : _bit_table[i]) {
+			if (bit.getType() != BITTYPE::CAR) {
+				is_used[bit.getGateId()] = true;
+				continue;
+			}
+			for (const Bit& carry_in : bit.getCarryIns()) {
+				is_used[carry_in.getGateId()] = true;
+			}
+		}
+	}
+	for (const Lookup& lookup : _lookups) {
+		for (int gate_id : lookup.gate_ids) is_used[gate_id] = true;
+	}
+	for (auto item : _excluded) {
+		is_used[item.first] = true;
+	}
+
+	float cost = 0;
+	for (Gate* gate : _gate_list) {
+		if (gate->getTypeStr() == "cp" && is_used[gate->getId()]) {
+			cost += _config.getCostToffoli();
+		}
+	}
+	if (_config.isSame()) cost += _config.getCostSingle() * _r;
+	return cost;
+}
+
+/* ===== Function Description:
+	Get the cost of the counters placed so far.
+*/
+float Optimizer::placedCounterCost() {
+	float cost = 0;
+	for (int i = 0; i < _r; ++i) {
+		for (int counter_size : _counter_sizes[i]) cost += _cost_model.counterCost(counter_size, i);
+	}
+	return cost;
+}
+
+/* ===== Function Description:
+	Get the cost of the adders implementing the current heights, and the number of adders in 'n_adder'.
+*/
+float Optimizer::closeCost(int& n_adder) {
+	float cost = 0;
+	n_adder = 0;
 	for (int i = _r - 1; i >= 0; --i) {
 		if (_heights[i] > n_adder) {
-			total_cost += countAdderCost(i) * (_heights[i] - n_adder);
+			cost += _cost_model.adderCost(i) * (_heights[i] - n_adder);
 			n_adder = _heights[i];
 		}
 	}
-	return make_pair(total_cost, n_adder);
+	return cost;
+}
+
+/* ===== Function Description:
+	Exact synthesis by branch-and-bound over the moves of 'optimize', starting from its result.
+	A node splits the first splittable peak, branching on the gate to split;
+	if no peak can be split, it branches on the counter method, on excluding each gate at the peaks by the single-gate method, and on the table lookup of 'doLookup',
+	and every node can also be closed with adders.
+	Nodes are pruned by 'remainingBound', and the subtrees are explored on a work-stealing pool with 'n_threads' threads (0: all hardware threads).
+	The search stops after 'max_nodes' nodes, or once the cost reaches the lower bound of the root.
+	Return the cost and the number of adders as 'optimize'. A complete search is optimal over these moves from the bit table of the block,
+	but not over other signed-digit forms of the angles (see 'recode') or the other engines, so 'getLowerBound' stays the bound of the root.
+	With a checkpoint, an improved state is saved as a final plan, so an interrupted search keeps its best result.
+*/
+pair<float, int> Optimizer::optimizeExact(int n_threads, long long max_nodes) {
+	const float EPS = 1e-3;
+	float fixed_cost = startCost();
+	float root_bound = fixed_cost + remainingBound();
+	if (_is_resumed) root_bound = _lower_bound;		// the bound of the remaining moves only holds for the path of the checkpoint
+	shared_ptr<Optimizer> root = make_shared<Optimizer>(*this);
+	root->_save_plan = nullptr;
+
+	pair<float, int> greedy = optimize();
+	Optimizer best = *this;
+	int best_n_adder = greedy.second;
+	atomic<float> best_cost(greedy.first);
+	mutex best_mutex;
+
+	atomic<long long> n_nodes(0);
+	atomic<bool> is_stopped(false);				// by the budget
+	auto offer = [&](const Optimizer& node, float cost, int n_adder) {
+		if (cost >= best_cost - EPS) return;
+		lock_guard<mutex> lock(best_mutex);
+		if (cost >= best_cost - EPS) return;
+		best = node;
+		best_n_adder = n_adder;
+		best_cost = cost;
+		if (!_save_plan || chrono::duration<double>(chrono::steady_clock::now() - _last_checkpoint).count() < _checkpoint_interval) return;
+		Optimizer plan = node;		// the best state so far, which is final since its cost includes the adders
+		plan._optimized_cost = cost;
+		plan._lower_bound = root_bound;
+		plan._is_optimized = true;
+		_save_plan(plan.writePlan());
+		_last_checkpoint = chrono::steady_clock::now();
+	};
+
+	WorkStealingPool pool(n_threads);
+	function<void(Optimizer&, float, int)> expand = [&](Optimizer& node, float cost, int worker) {
+		float bound = cost + node.remainingBound();
+		if (bound >= best_cost - EPS || best_cost <= root_bound + EPS) return;
+		if (is_stopped || ++n_nodes > max_nodes) {
+			is_stopped = true;
+			return;
+		}
+
+		vector<int> peaks;
+		node.updatePeaks(peaks);
+		int n_adder;
+		offer(node, cost + node.closeCost(n_adder), n_adder);
+		if (node._max_height == 0) return;
+
+		// children as moves with their costs, applied to copies of the node only when explored (returning the change of the cost of the counters)
+		vector<pair<function<float(Optimizer&)>, float>> children;
+		for (int index : peaks) {
+			vector<int> candidates = node.splitCandidates(index);
+			for (int gate_id : candidates) {
+				children.emplace_back([index, gate_id](Optimizer& child) { child.splitGate(index, gate_id); return 0.0f; }, cost);
+			}
+			if (!candidates.empty()) break;
+		}
+		if (children.empty()) {
+			shared_ptr<Optimizer> counter_child = make_shared<Optimizer>(node);
+			int dealing_peak_index = 0;
+			float cost_counter = counter_child->doCounter(counter_child->_heights, counter_child->_n_carry, counter_child->_n_counter, counter_child->_counter_sizes, peaks, dealing_peak_index);
+			if (cost_counter != COST_INF && dealing_peak_index < peaks.size()) {
+				cost_counter -= _cost_model.adderCost(peaks[dealing_peak_index]);
+				offer(*counter_child, cost + cost_counter + counter_child->closeCost(n_adder), n_adder);
+			}	// a new adder is used
+			else if (cost_counter != COST_INF) {
+				children.emplace_back([counter_child](Optimizer& child) { child = *counter_child; return 0.0f; }, cost + cost_counter);
+			}
+
+			bool can_exclude = true;
+			set<int> gates;
+			for (int index : peaks) {
+				if (node._heights[index] - node._n_carry[index] <= 0) can_exclude = false;
+				for (Bit& bit : node._bit_table[index]) gates.insert(bit.getGateId());
+			}
+			for (int gate_id : gates) {
+				if (!can_exclude) break;
+				if (cost + node.excludeCost(gate_id) - node.placedCounterCost() + node.remainingBound(gate_id) >= best_cost - EPS) continue;	// the counters may shrink
+				children.emplace_back([gate_id](Optimizer& child) { return child.excludeGates({ gate_id }); }, cost + node.excludeCost(gate_id));
+			}
+
+			vector<int> new_lookup;
+			int n_levels;
+			float cost_lookup = node.doLookup(new_lookup, peaks, n_levels);
+			if (cost_lookup != COST_INF) {
+				children.emplace_back([new_lookup](Optimizer& child) { return child.lookupGates(new_lookup); }, cost + cost_lookup);
+			}
+		}
+
+		shared_ptr<Optimizer> shared_node;		// a copy of the node for the children run by other threads
+		for (auto& child : children) {
+			if (is_stopped) break;
+			if (pool.isHungry()) {
+				if (!shared_node) shared_node = make_shared<Optimizer>(node);
+				pool.push(worker, [&expand, shared_node, child](int worker) {
+					Optimizer child_node = *shared_node;
+					float cost_change = child.first(child_node);
+					expand(child_node, child.second + cost_change, worker);
+				});
+			}	// share the subtree with an idle thread
+			else {
+				Optimizer child_node = node;
+				float cost_change = child.first(child_node);
+				expand(child_node, child.second + cost_change, worker);
+			}
+		}
+	};
+	pool.push(0, [&](int worker) { expand(*root, fixed_cost, worker); });
+	pool.run();
+
+	auto save_plan = _save_plan;
+	auto last_checkpoint = _last_checkpoint;
+	*this = best;
+	_save_plan = save_plan;
+	_last_checkpoint = last_checkpoint;
+	_is_optimized = true;
+	_is_resumed = false;
+	_optimized_cost = best_cost;
+	_lower_bound = min(root_bound, (float)best_cost);
+	return make_pair((float)best_cost, best_n_adder);
+}
+
+/* ===== Function Description:
+	Get a lower bound on the cost of the current state, without optimizing.
+*/
+float Optimizer::lowerBound() {
+	_cost_model = CostModel(_config, *max_element(_heights.begin(), _heights.end()));
+	return fixedCost() + remainingBound();
+}
+
+/* ===== Function Description:
+	Get a lower bound on the cost of the moves and adders still needed from the current state (admissible for 'optimizeExact'),
+	as if 'excluded_gate' (if not -1) were also excluded. It is the larger of two bounds, which only depend on the values of the gates,
+	so they also hold for other signed-digit forms of the angles (see 'recode').
+	By the first adder: the value of a gate is kept by splits and counters, so unless the gate is excluded at the cost of a single rotation,
+	some bit of it stays at or below the lowest set bit of its value, and the first adder must end there.
+	(A table lookup keeps the bound, since its adder also ends at or below the lowest bits of its gates.)
+	The bound is minimized over the number k of excluded gates, which at best are the ones with the k lowest bits,
+	and cost at least the k cheapest single rotations.
+	By the heights: if M_i adders reach column i, the adders cost at least sum_i w_i * M_i with the increments w_i of the adder cost,
+	and they hold less than M_i * 2^-i turns in the columns from i on.
+	The bits of a gate in these columns add up to its value modulo 2^-i turns, so they hold at least its distance d_i to a multiple of 2^-i.
+	Only counters move bits out of these columns, and a counter of c bits costs at least c - 1 Toffoli gates for what it moves,
+	so with w_i capped at the cost of a Toffoli gate, a gate costs at least B = sum_i w_i * 2^i * d_i, unless it is moved to a single rotation
+	or to a table lookup of k gates, whose share is the table and an adder to its lowest bit over k.
+	The gates sharing a representative qubit may be summed (see 'compressorTable'), so B is taken of their sum,
+	less the savings of moving each gate, and the counters placed so far are given back.
+	(Only the top 64 columns are considered.)
+*/
+float Optimizer::remainingBound(int excluded_gate) {
+	int r = min(_r, 64);
+	unsigned long long mask = (r == 64) ? ~0ULL : (1ULL << r) - 1;
+	vector<unsigned long long> values(_n, 0);	// in units of 2^-r turns
+	for (int i = 0; i < r; ++i) {
+		for (Bit& bit : _bit_table[i]) {
+			if (bit.isPos())		values[bit.getGateId()] += 1ULL << (r - 1 - i);
+			else if (bit.isNeg())	values[bit.getGateId()] -= 1ULL << (r - 1 - i);
+		}
+	}
+
+	vector<int> lowest_bits;
+	vector<float> single_costs;
+	for (int gate_id = 0; gate_id < _n; ++gate_id) {
+		if ((values[gate_id] & mask) == 0 || gate_id == excluded_gate) continue;
+		lowest_bits.emplace_back(r - 1 - __builtin_ctzll(values[gate_id] & mask));
+		single_costs.emplace_back(excludeCost(gate_id));
+	}
+	sort(lowest_bits.rbegin(), lowest_bits.rend());
+	sort(single_costs.begin(), single_costs.end());		// k excluded gates cost at least the k cheapest ones
+
+	float bound = 0;
+	for (float cost : single_costs) bound += cost;		// all gates are excluded
+	float excluded_cost = 0;
+	for (int k = 0; k < lowest_bits.size(); ++k) {
+		bound = min(bound, excluded_cost + _cost_model.adderCost(lowest_bits[k]));
+		excluded_cost += single_costs[k];
+	}
+
+	// the cheapest adder reaching each column, and the capped increments
+	vector<float> reach_costs(r), weights(r);
+	for (int i = r - 1; i >= 0; --i) {
+		reach_costs[i] = (i == r - 1) ? _cost_model.adderCost(i) : min(_cost_model.adderCost(i), reach_costs[i + 1]);
+	}
+	for (int i = 0; i < r; ++i) {
+		weights[i] = min(reach_costs[i] - (i > 0 ? reach_costs[i - 1] : 0), (float)_config.getCostToffoli());
+	}
+
+	auto gateBound = [&](unsigned long long value) {
+		double gate_bound = 0;
+		for (int i = 0; i < r; ++i) {
+			unsigned long long modulus_mask = (r - i == 64) ? ~0ULL : (1ULL << (r - i)) - 1;
+			unsigned long long rest = value & modulus_mask;
+			double distance = min(rest, modulus_mask - rest + 1);
+			gate_bound += weights[i] * ldexp(distance, i - r);
+		}
+		return gate_bound;
+	};
+	map<int, pair<unsigned long long, double>> groups;	// representative qubit (as in 'compressorTable') -> sum of the values, and the savings of its gates
+	for (int gate_id = 0; gate_id < _n; ++gate_id) {
+		unsigned long long value = values[gate_id] & mask;
+		if (value == 0 || gate_id == excluded_gate) continue;
+		double gate_bound = gateBound(value);
+		double moved_cost = excludeCost(gate_id);
+		float reach_cost = reach_costs[r - 1 - __builtin_ctzll(value)];
+		for (int width = 1; width <= _config.getLookupWidth(); ++width) {
+			moved_cost = min(moved_cost, (double)(_cost_model.lookupCost(width) + reach_cost) / width);
+		}
+		Gate* gate = _gate_list[gate_id];
+		auto& group = groups[(gate->getNumQubits() == 1) ? -1 - gate->getQubit(0) : gate_id];
+		group.first += value;
+		group.second += max(gate_bound - moved_cost, 0.0);
+	}
+	double height_bound = 0;
+	for (auto& item : groups) {
+		height_bound += max(gateBound(item.second.first & mask) - item.second.second, 0.0);
+	}
+	height_bound -= placedCounterCost();
+	return max(bound, (float)height_bound);
 }
 
 // ==================================================
@@ -278,6 +617,27 @@ bool Optimizer::split(int index, int index_bound) {
 	return true;
 }
 
+/* ===== Function Description:
+	Get the gates that can be split at 'index' column without a bound on the lower columns,
+	i.e., the gates whose bits discharge lower bits of the opposite sign, and '_n' if any bit can be split.
+*/
+vector<int> Optimizer::splitCandidates(int index) {
+	vector<int> candidates;
+	if (_heights[index] - _n_carry[index] - _counter_sizes[index].size() <= 0) return candidates;
+
+	unordered_set<int> no_gates;
+	int any_gate = findSplittedGate(index, no_gates, no_gates, _r);
+	if (any_gate != -1) candidates.emplace_back(any_gate);
+	for (Bit& bit : _bit_table[index]) {
+		unordered_set<int> gate = { bit.getGateId() };
+		int gate_id = bit.isPos() ? findSplittedGate(index, gate, no_gates, _r) : findSplittedGate(index, no_gates, gate, _r);
+		if (gate_id != -1 && find(candidates.begin(), candidates.end(), gate_id) == candidates.end()) {
+			candidates.emplace_back(gate_id);
+		}
+	}
+	return candidates;
+}
+
 // ==================================================
 
 /* ===== Function Description:
@@ -296,18 +656,18 @@ int Optimizer::findTargetCounterMin(const vector<int>& counter_sizes) {
 /* ===== Function Description:
 	Try to merge two counters.
 */
-int Optimizer::mergeCounter(vector<int>& new_heights, vector<int>& new_n_carry, vector<int>& new_n_counter, vector<vector<int>>& new_counter_sizes, const vector<int>& peaks, int& dealing_peak_index) {
+float Optimizer::mergeCounter(vector<int>& new_heights, vector<int>& new_n_carry, vector<int>& new_n_counter, vector<vector<int>>& new_counter_sizes, const vector<int>& peaks, int& dealing_peak_index) {
 	int index = peaks[dealing_peak_index];
 
-	int adder_saved_cost = 0;
-	int counter_saved_cost = 0;
-	int counter_extra_cost = 0;
+	float adder_saved_cost = 0;
+	float counter_saved_cost = 0;
+	float counter_extra_cost = 0;
 	int new_peak = peaks[dealing_peak_index];
 
 	// remove the last counter
 	int original_counter_size = new_counter_sizes[index].back();
 	new_counter_sizes[index].pop_back();
-	counter_saved_cost = countCounterCost(original_counter_size, index);
+	counter_saved_cost = _cost_model.counterCost(original_counter_size, index);
 	int original_counter_bitlength = log2(original_counter_size) + 1;
 
 	for (; dealing_peak_index < peaks.size(); ++dealing_peak_index) {
@@ -316,8 +676,8 @@ int Optimizer::mergeCounter(vector<int>& new_heights, vector<int>& new_n_carry,
 			else										new_peak = -1;
 		} // this range is also saved
 	}
-	if (new_peak == -1) adder_saved_cost = countAdderCost(index);
-	else			          adder_saved_cost = countAdderCost(index) - countAdderCost(new_peak);
+	if (new_peak == -1) adder_saved_cost = _cost_model.adderCost(index);
+	else			          adder_saved_cost = _cost_model.adderCost(index) - _cost_model.adderCost(new_peak);
 	for (int i = 0; i < original_counter_bitlength && index - i >= 0; ++i) {
 		new_heights[index - i]--;
 		if (i > 0) new_n_carry[index - i]--;
@@ -334,17 +694,17 @@ int Optimizer::mergeCounter(vector<int>& new_heights, vector<int>& new_n_carry,
 			new_n_carry[index - new_bitlength + 1]++;
 			new_heights[index - new_bitlength + 1]++;
 			if (new_heights[index - new_bitlength + 1] >= _max_height) {
-				return INT_MAX;
+				return COST_INF;
 			}  // cannot apply counter method	// this restriction may be losen
 		}
-		counter_extra_cost += countCounterCost(new_counter_sizes[index][target_counter], index) - countCounterCost(new_counter_sizes[index][target_counter] - 1, index);
+		counter_extra_cost += _cost_model.counterMarginalCost(new_counter_sizes[index][target_counter], index);
 	}
 
 	if (adder_saved_cost + counter_saved_cost > counter_extra_cost) {
 		return (counter_extra_cost - counter_saved_cost);
 	}
 	else {
-		return INT_MAX;
+		return COST_INF;
 	}  // do not apply counter
 }
 
@@ -353,12 +713,12 @@ int Optimizer::mergeCounter(vector<int>& new_heights, vector<int>& new_n_carry,
 	The remaining peak columns are dealt by adder method.
 	Return the cost.
 */
-int Optimizer::doCounter(vector<int>& new_heights, vector<int>& new_n_carry, vector<int>& new_n_counter, vector<vector<int>>& new_counter_sizes, const vector<int>& peaks, int& dealing_peak_index) {
-	int cost_adder = 0;
+float Optimizer::doCounter(vector<int>& new_heights, vector<int>& new_n_carry, vector<int>& new_n_counter, vector<vector<int>>& new_counter_sizes, const vector<int>& peaks, int& dealing_peak_index) {
+	float cost_adder = 0;
 	for (dealing_peak_index = 0; dealing_peak_index < peaks.size(); dealing_peak_index++) {
 		int index = peaks[dealing_peak_index];
 		if (new_heights[index] - new_n_carry[index] <= 0) {
-			return INT_MAX;
+			return COST_INF;
 		} // cannot apply counter
 
 		if (new_heights[index] - new_n_carry[index] - new_counter_sizes[index].size() <= 0) {	// can only merge old counters
@@ -372,8 +732,8 @@ int Optimizer::doCounter(vector<int>& new_heights, vector<int>& new_n_carry, vec
 			vector<vector<int>> temp_counter_sizes = new_counter_sizes;
 			int temp_dealing_peak_index = dealing_peak_index;
 
-			int cost = mergeCounter(temp_heights, temp_n_carry, temp_n_counter, temp_counter_sizes, peaks, temp_dealing_peak_index);
-			if (cost == INT_MAX) break;	// failed
+			float cost = mergeCounter(temp_heights, temp_n_carry, temp_n_counter, temp_counter_sizes, peaks, temp_dealing_peak_index);
+			if (cost == COST_INF) break;	// failed
 
 			cost_adder += cost;
 			new_heights = temp_heights;
@@ -384,14 +744,14 @@ int Optimizer::doCounter(vector<int>& new_heights, vector<int>& new_n_carry, vec
 		}
 		else {	// merge a new bit into existing counter 
 
-			int adder_saved_cost = 0;
-			int counter_extra_cost = 0;
+			float adder_saved_cost = 0;
+			float counter_extra_cost = 0;
 
 			if (dealing_peak_index + 1 < peaks.size()) {
-				adder_saved_cost = countAdderCost(peaks[dealing_peak_index]) - countAdderCost(peaks[dealing_peak_index + 1]);
+				adder_saved_cost = _cost_model.adderCost(peaks[dealing_peak_index]) - _cost_model.adderCost(peaks[dealing_peak_index + 1]);
 			}
 			else {
-				adder_saved_cost = countAdderCost(peaks[dealing_peak_index]);
+				adder_saved_cost = _cost_model.adderCost(peaks[dealing_peak_index]);
 			}
 
 			bool create_new_counter = true;
@@ -403,7 +763,7 @@ int Optimizer::doCounter(vector<int>& new_heights, vector<int>& new_n_carry, vec
 			}
 
 			if (create_new_counter) { // merge two bits to form a counter
-				counter_extra_cost = countCounterCost(2, index);
+				counter_extra_cost = _cost_model.counterCost(2, index);
 				if (counter_extra_cost >= adder_saved_cost) {
 					break;
 				}  // do not use counter method
@@ -427,13 +787,11 @@ int Optimizer::doCounter(vector<int>& new_heights, vector<int>& new_n_carry, vec
 
 				int new_bitlength = log2(new_counter_sizes[index][target_counter] + 1) + 1;
 				bool need_new_carry = (new_counter_sizes[index][target_counter] + 1 == pow(2, new_bitlength - 1));
-				if (need_new_carry && index - new_bitlength + 1 >= 0) {
-					new_heights[index - new_bitlength + 1]++;
-					if (new_heights[index - new_bitlength + 1] >= _max_height) {
-						break;
-					}  // cannot apply counter method	// this restriction may be losen
-				}
-				counter_extra_cost = countCounterCost(new_counter_sizes[index][target_counter] + 1, index) - countCounterCost(new_counter_sizes[index][target_counter], index);
+				int carry_index = index - new_bitlength + 1;	// column of the new carry bit
+				if (need_new_carry && carry_index >= 0 && new_heights[carry_index] + 1 >= _max_height) {
+					break;
+				}  // cannot apply counter method	// this restriction may be losen
+				counter_extra_cost = _cost_model.counterMarginalCost(new_counter_sizes[index][target_counter] + 1, index);
 				if (counter_extra_cost >= adder_saved_cost) {
 					break;
 				}  // do not use counter method
@@ -442,9 +800,9 @@ int Optimizer::doCounter(vector<int>& new_heights, vector<int>& new_n_carry, vec
 				new_n_counter[index]++;
 				new_counter_sizes[index][target_counter]++;
 				new_heights[index]--;
-				if (need_new_carry && index - new_bitlength >= 0) {
-					new_heights[index - new_bitlength]++;
-					new_n_carry[index - new_bitlength]++;
+				if (need_new_carry && carry_index >= 0) {
+					new_heights[carry_index]++;
+					new_n_carry[carry_index]++;
 				}
 				cost_adder += counter_extra_cost;
 			}
@@ -452,7 +810,7 @@ int Optimizer::doCounter(vector<int>& new_heights, vector<int>& new_n_carry, vec
 	}
  
 	if (dealing_peak_index < peaks.size()) {
-		cost_adder += countAdderCost(peaks[dealing_peak_index]);
+		cost_adder += _cost_model.adderCost(peaks[dealing_peak_index]);
 	}	// new adder is still needed ('break' is triggered)
 
 	return cost_adder;
@@ -469,14 +827,372 @@ void Optimizer::removeExcluded() {
 	}
 }
 
+/* ===== Function Description:
+	Shrink the splittings and counters whose input bits are excluded by the single-gate method.
+	A cancelled splitting takes back its lower bits from the nearest columns, as 'splitGateAny' fills them.
+	Note that the excluded bits are assumed to be outside the counters when updating '_heights'.
+*/
+void Optimizer::shrinkCounters() {
+	for (int i = 0; i < _r; ++i) {
+		while (_n_split_from[i] > (int)_bit_table[i].size() + _n_split_to[i]) {
+			_n_split_from[i]--;
+			_heights[i]++;
+
+			int n_needed_bits = 1;
+			for (int j = i + 1; j < _r && n_needed_bits > 0; ++j) {
+				n_needed_bits *= 2;
+				int n_taken = min(n_needed_bits, _n_split_to[j]);
+				_n_split_to[j] -= n_taken;
+				_heights[j] -= n_taken;
+				n_needed_bits -= n_taken;
+			}
+		}
+
+		int n_bits = _bit_table[i].size() - _n_split_from[i] + _n_split_to[i];
+		while (_n_counter[i] > n_bits) {
+			int& counter_size = _counter_sizes[i].back();	// the smallest one
+			int bitlength = log2(counter_size) + 1;
+			if (counter_size == pow(2, bitlength - 1) && i - bitlength + 1 >= 0) {
+				_n_carry[i - bitlength + 1]--;
+				_heights[i - bitlength + 1]--;
+			}	// the highest carry bit is gone
+			counter_size--;
+			_n_counter[i]--;
+			_heights[i]++;
+
+			if (counter_size == 1) {
+				_counter_sizes[i].pop_back();
+				_n_counter[i]--;
+			}	// a single bit is not a counter
+		}
+	}
+}
+
+/* ===== Function Description:
+	Exclude the bits of 'gates', which are applied as single rotations instead.
+	Return the change of the cost of the counters (see 'removeGates').
+*/
+float Optimizer::excludeGates(const unordered_set<int>& gates) {
+	double unit = _config.isSame() ? (int)(_last_angle * pow(2, _r)) : 1;	// a bit of the special case represents multiples of the angle
+	return removeGates(gates, [&](const Bit& bit, int i) {
+		_excluded[bit.getGateId()] += (bit.getType() == BITTYPE::NEG ? -1 : 1) * unit * pow(2, (-1 - i)) * 2 * M_PI;
+	});
+}
+
+/* ===== Function Description:
+	Remove the bits of 'gates' from the bit table, and pass each removed bit with its column to 'take_bit'.
+	Return the change of the cost of the counters, which shrink if they lose their bits (0 or negative),
+	so that the cost paid for them matches the counters that are written.
+*/
+float Optimizer::removeGates(const unordered_set<int>& gates, const function<void(const Bit&, int)>& take_bit) {
+	float counter_cost = placedCounterCost();
+	for (int i = 0; i < _r; i++) {
+		for (Bit& bit : _bit_table[i]) {
+			if (gates.count(bit.getGateId()) > 0 && _heights[i] > 0) {
+				bit.setInactivate();
+				take_bit(bit, i);
+				_heights[i]--;
+			}
+		}
+	}
+	removeExcluded();
+	shrinkCounters();
+	return placedCounterCost() - counter_cost;
+}
+
+/* ===== Function Description:
+	Move the bits of 'gates' into a table lookup, which adds the sum of their angles selected by their representative qubits by one adder.
+	Return the change of the cost of the counters (see 'removeGates').
+*/
+float Optimizer::lookupGates(const vector<int>& gates) {
+	Lookup lookup;
+	lookup.gate_ids = gates;
+	lookup.digits.assign(gates.size(), vector<int>(_r, 0));
+	float counter_change = removeGates(unordered_set<int>(gates.begin(), gates.end()), [&](const Bit& bit, int i) {
+		int k = find(gates.begin(), gates.end(), bit.getGateId()) - gates.begin();
+		lookup.digits[k][i] += (bit.getType() == BITTYPE::NEG) ? -1 : 1;
+	});
+	_lookups.emplace_back(lookup);
+	return counter_change;
+}
+
+/* ===== Function Description:
+	Get the gates that may form a table lookup in the order of preference:
+	by their bits at the peaks, and then by all their bits (in the columns with nonzero heights).
+	The single-qubit gates on a qubit already taken are skipped, so that the address bits are distinct,
+	and at most the lookup width of the config are returned.
+*/
+vector<int> Optimizer::lookupCandidates(const vector<int>& peaks) {
+	vector<int> n_bits(_n, 0), n_peak_bits(_n, 0);
+	for (int i = 0; i < _r; ++i) {
+		if (_heights[i] == 0) continue;
+		for (Bit& bit : _bit_table[i]) {
+			n_bits[bit.getGateId()]++;
+		}
+	}
+	for (int index : peaks) {
+		for (Bit& bit : _bit_table[index]) {
+			n_peak_bits[bit.getGateId()]++;
+		}
+	}
+	vector<int> gates;
+	for (int gate_id = 0; gate_id < _n; ++gate_id) {
+		if (n_bits[gate_id] > 0) gates.emplace_back(gate_id);
+	}
+	sort(gates.begin(), gates.end(), [&](int a, int b) {
+		if (n_peak_bits[a] != n_peak_bits[b]) return n_peak_bits[a] > n_peak_bits[b];
+		if (n_bits[a] != n_bits[b]) return n_bits[a] > n_bits[b];
+		return a < b;
+	});
+
+	vector<int> candidates;
+	set<int> single_qubits;
+	for (int gate_id : gates) {
+		if (candidates.size() == _config.getLookupWidth()) break;
+		if (_gate_list[gate_id]->getNumQubits() == 1 && !single_qubits.insert(_gate_list[gate_id]->getQubit(0)).second) continue;
+		candidates.emplace_back(gate_id);
+	}
+	return candidates;
+}
+
+/* ===== Function Description:
+	Get the cost of a table lookup (see 'lookupGates') as written by 'exportQasmWriteLookup':
+	the lookup, the unlookup, and the adder ending at the last bit of its table (see 'lookupTable'),
+	which may be above the lowest bit of its gates since the digits of the sums can cancel out.
+*/
+float Optimizer::lookupCost(const Lookup& lookup) {
+	int last_bit;
+	lookupTable(lookup, last_bit);
+	if (last_bit == -1) return 0;
+	return _cost_model.lookupCost(lookup.gate_ids.size()) + _cost_model.adderCost(last_bit);
+}
+
+/* ===== Function Description:
+	Try the table-lookup method [C. Gidney, 2019] to reduce the height at each peak column by several levels at once.
+	The first w gates of 'lookupCandidates' form a window for each w,
+	and the one with the lowest cost per level is returned in 'new_lookup', with the number of levels in 'n_levels',
+	where the levels are counted on a copy of the state, since removing the gates also shrinks the counters.
+	Return the cost.
+*/
+float Optimizer::doLookup(vector<int>& new_lookup, const vector<int>& peaks_remaining, int& n_levels) {
+	n_levels = 0;
+	if (_config.getLookupWidth() == 0) return COST_INF;
+
+	int max_height = *max_element(_heights.begin(), _heights.end());
+	vector<int> candidates = lookupCandidates(peaks_remaining);
+	float best_cost = COST_INF;
+	for (int width = 1; width <= candidates.size(); ++width) {
+		vector<int> window(candidates.begin(), candidates.begin() + width);
+		Optimizer trial = *this;
+		trial.lookupGates(window);
+		int levels = max_height - *max_element(trial._heights.begin(), trial._heights.end());
+		float cost = lookupCost(trial._lookups.back());
+		if (levels > 0 && (best_cost == COST_INF || cost * n_levels < best_cost * levels)) {
+			best_cost = cost;
+			n_levels = levels;
+			new_lookup = window;
+		}
+	}
+	return best_cost;
+}
+
+/* ===== Function Description:
+	Move windows of gates into table lookups before the other moves, as long as the total cost decreases,
+	which is checked by running the greedy moves on copies of the state.
+	Since the cheap counters are taken first level by level, 'doLookup' alone misses the lookups that pay off over many levels.
+	Return the cost of the lookups.
+*/
+float Optimizer::planLookups() {
+	const float EPS = 1e-3;
+	Optimizer base = *this;
+	base._save_plan = nullptr;
+	base._is_lookup_trial = true;
+	float best_cost = base.optimize().first;
+
+	float lookup_cost = 0;
+	vector<int> peaks;
+	for (updatePeaks(peaks); _max_height > 0; updatePeaks(peaks)) {
+		vector<int> candidates = lookupCandidates(peaks);
+		vector<int> best_window;
+		float best_window_cost = 0;
+		for (int width = 1; width <= candidates.size(); ++width) {
+			vector<int> window(candidates.begin(), candidates.begin() + width);
+			Optimizer trial = *this;
+			trial._save_plan = nullptr;
+			trial._is_lookup_trial = true;
+			trial.lookupGates(window);
+			float cost = lookupCost(trial._lookups.back());
+			float total_cost = lookup_cost + cost + trial.optimize().first;
+			if (total_cost < best_cost - EPS) {
+				best_cost = total_cost;
+				best_window = window;
+				best_window_cost = cost;
+			}
+		}
+		if (best_window.empty()) break;
+		lookupGates(best_window);
+		lookup_cost += best_window_cost;
+	}
+	return lookup_cost;
+}
+
+/* ===== Function Description:
+	Get the input levels of the Hamming-weight phasing of the special case, where each gate adds 1 to the weight.
+	Single-qubit gates on the same qubit share their representative qubit,
+	which is listed once at each level 2^j of the binary representation of their number.
+	Otherwise, the input levels of the carry-save compressor are the carry-ins of its adder row (see 'compressorTable').
+*/
+void Optimizer::hammingLevels(vector<vector<int>>& levels) {
+	levels.clear();
+	if (!_config.isSame()) {
+		for (int j = 0; j < _r; ++j) {
+			if (_bit_table[_r - 1 - j].empty()) continue;
+			levels.resize(j + 1);
+			for (const Bit& carry_in : _bit_table[_r - 1 - j][0].getCarryIns()) {
+				levels[j].emplace_back(carry_in.getGateId());
+			}
+		}
+		return;
+	}
+
+	map<int, vector<int>> single_gates;		// qubit -> single-qubit gates on it
+	vector<pair<int, int>> inputs;			// (gate id, multiplicity) in the order of the gates
+	for (Gate* gate : _gate_list) {
+		if (gate->getNumQubits() > 1) {
+			inputs.emplace_back(gate->getId(), 1);
+			continue;
+		}
+		vector<int>& gates = single_gates[gate->getQubit(0)];
+		if (gates.empty()) inputs.emplace_back(gate->getId(), 0);
+		gates.emplace_back(gate->getId());
+	}
+	for (auto& input : inputs) {
+		int multiplicity = (input.second > 0) ? input.second : single_gates[_gate_list[input.first]->getQubit(0)].size();
+		for (int j = 0; (multiplicity >> j) > 0; ++j) {
+			if (levels.size() <= j) levels.emplace_back();
+			if ((multiplicity >> j) & 1) levels[j].emplace_back(input.first);
+		}
+	}
+}
+
+/* ===== Function Description:
+	Build the network of the Hamming-weight phasing of the special case (or of the carry-save compressor) by 'buildHammingTree'
+	on the levels of 'hammingLevels' and the columns of the Fourier state,
+	where wire k < _n is the representative qubit of the k-th gate, and get the last column of the weight bits in 'last_bit' (-1 if none).
+	Return the number of ancillas.
+*/
+int Optimizer::buildHamming(vector<NetGate>& gates, vector<int>& weights, int& last_bit) {
+	vector<vector<int>> levels;
+	hammingLevels(levels);
+	int n_ancilla = buildHammingTree(levels, _n, gates, weights, _r);
+	last_bit = -1;
+	for (int j = 0; j < weights.size() && _r - 1 - j >= 0; ++j) {
+		if (weights[j] != -1) last_bit = max(last_bit, _r - 1 - j);
+	}
+	return n_ancilla;
+}
+
+/* ===== Function Description:
+	Get the cost of the special case by Hamming-weight phasing (or of the carry-save compressor):
+	the weight of the representative qubits is computed by 'buildHammingTree' and added into the Fourier state by one adder.
+*/
+float Optimizer::hammingCost() {
+	vector<NetGate> gates;
+	vector<int> weights;
+	int last_bit;
+	int n_wires = _n + buildHamming(gates, weights, last_bit);
+	int n_toffoli, toffoli_depth;
+	countNetworkToffoli(gates, n_wires, n_toffoli, toffoli_depth);
+	return fixedCost() + n_toffoli * _config.getCostToffoli() + ((last_bit == -1) ? 0 : _cost_model.adderCost(last_bit));
+}
+
+/* ===== Function Description:  // O(#bits + #gates * precision)
+	Get the bit table of the carry-save compressor outside the special case, from the bits of the imported gates (before any move):
+	one adder row whose i-th bit is the compression of its carry-ins, the inputs of weight 2^(_r - 1 - i).
+	The values of the gates sharing a representative qubit (the single-qubit gates on a qubit) are summed modulo 2^_r,
+	and each sum is given by the POS bits of its first gate, or by the NEG bits of its negation if they are fewer
+	(since w * (1 - x) = -w * x up to a global phase).
+*/
+vector<vector<Bit>> Optimizer::compressorTable() {
+	map<int, int> first_gates;		// representative qubit (-1 - qubit of single-qubit gates or gate id of the others) -> first gate
+	vector<vector<int>> sums(_n);	// first gate -> sum of the digits at each column
+	for (int i = 0; i < _r; ++i) {
+		for (Bit& bit : _bit_table[i]) {
+			Gate* gate = _gate_list[bit.getGateId()];
+			int factor = (gate->getNumQubits() == 1) ? -1 - gate->getQubit(0) : gate->getId();
+			vector<int>& sum = sums[first_gates.emplace(factor, gate->getId()).first->second];
+			if (sum.empty()) sum.assign(_r, 0);
+			sum[i] += bit.isNeg() ? -1 : 1;
+		}
+	}
+
+	vector<vector<Bit>> inputs(_r);
+	for (int gate_id = 0; gate_id < _n; ++gate_id) {
+		if (sums[gate_id].empty()) continue;
+		vector<int> digits[2] = { vector<int>(_r, 0), vector<int>(_r, 0) };		// the sum and its negation modulo 2^_r
+		long long carries[2] = { 0, 0 };
+		int n_ones[2] = { 0, 0 };
+		for (int i = _r - 1; i >= 0; --i) {
+			for (int is_neg = 0; is_neg < 2; ++is_neg) {
+				long long sum = (is_neg ? -sums[gate_id][i] : sums[gate_id][i]) + carries[is_neg];
+				digits[is_neg][i] = sum & 1;
+				carries[is_neg] = (sum - digits[is_neg][i]) / 2;
+				n_ones[is_neg] += digits[is_neg][i];
+			}
+		}
+		int is_neg = (n_ones[1] < n_ones[0]) ? 1 : 0;
+		for (int i = 0; i < _r; ++i) {
+			if (digits[is_neg][i] == 1) inputs[i].emplace_back(Bit(is_neg ? BITTYPE::NEG : BITTYPE::POS, _gate_list[gate_id]));
+		}
+	}
+
+	vector<vector<Bit>> table(_r);
+	for (int i = 0; i < _r; ++i) {
+		if (!inputs[i].empty()) table[i].emplace_back(Bit(inputs[i], 0));
+	}
+	return table;
+}
+
+/* ===== Function Description:
+	Replace the state by Hamming-weight phasing: the bit table becomes one adder row of the counter of all gates at the LSB column,
+	whose carries are computed by 'buildHammingTree' when exported.
+	Outside the special case, the bit table becomes 'compressed_table' of the carry-save compressor (see 'compressorTable') instead.
+*/
+void Optimizer::useHamming(const vector<vector<Bit>>& compressed_table) {
+	if (_config.isSame()) {
+		vector<Bit> carry_ins;
+		for (Gate* gate : _gate_list) {
+			carry_ins.emplace_back(Bit(BITTYPE::POS, gate));
+		}
+		_bit_table.assign(_r, vector<Bit>());
+		for (int k = 0; (_n >> k) > 0 && _r - 1 - k >= 0; ++k) {
+			_bit_table[_r - 1 - k].emplace_back(Bit(carry_ins, k));
+		}
+	}
+	else {
+		_bit_table = compressed_table;
+	}
+	for (int i = 0; i < _r; ++i) {
+		_heights[i] = _bit_table[i].size();
+		_n_carry[i] = 0;
+		_n_counter[i] = 0;
+		_n_split_from[i] = 0;
+		_n_split_to[i] = 0;
+		_counter_sizes[i].clear();
+	}
+	_excluded.clear();
+	_lookups.clear();
+	_is_hamming = true;
+}
+
 /* ===== Function Description:
 	Try the single-gate method to reduce the height at each peak column.
 	Return the cost.
 */
-int Optimizer::doSingle(unordered_set<int>& new_excluded, vector<int> peaks_remaining) {
+float Optimizer::doSingle(unordered_set<int>& new_excluded, vector<int> peaks_remaining) {
 	for (int index : peaks_remaining) {
 		if (_heights[index] - _n_carry[index] <= 0) {
-			return INT_MAX;
+			return COST_INF;
 		}  // cannot use single-gate method
 	}
 	
@@ -502,7 +1218,7 @@ int Optimizer::doSingle(unordered_set<int>& new_excluded, vector<int> peaks_rema
 			}
 		}
 		if (max_involved_gate == -1) {
-			return INT_MAX;
+			return COST_INF;
 		}
 
 		new_excluded.insert(max_involved_gate);
@@ -513,7 +1229,10 @@ int Optimizer::doSingle(unordered_set<int>& new_excluded, vector<int> peaks_rema
 	}
 
 	// calculate cost // some counters may be saved, but we ignore them for simplicity
-	int extra_cost = _cost_single * new_excluded.size();
+	float extra_cost = 0;
+	for (int gate_id : new_excluded) {
+		extra_cost += excludeCost(gate_id);
+	}
 	return extra_cost;
 }
 
@@ -523,6 +1242,9 @@ int Optimizer::doSingle(unordered_set<int>& new_excluded, vector<int> peaks_rema
 	Turn all flexibilities into concrete implementations.
 */
 void Optimizer::concrete() {
+	if (_is_concrete) return;
+	_is_concrete = true;
+
 	// bit-spliting
 	for (int i = 0; i < _r; ++i) {
 		while (_n_split_from[i] > 0) {
@@ -534,6 +1256,8 @@ void Optimizer::concrete() {
 		assert(_n_split_from[i] == 0);
 	}
 
+	float model_counter_cost = placedCounterCost();
+
 	// carries
 	for (int i = _r - 1; i >= 0; --i) {
 		for (int counter_size : _counter_sizes[i]) {
@@ -561,6 +1285,14 @@ void Optimizer::concrete() {
 	for (int i = 0; i < _r; i++) {
 		assert(_bit_table[i].size() == _heights[i]);
 	}
+
+	allocateAncilla();
+
+	// the bits split from one gate may share a counter, and then their product is the gate itself (see 'planProducts'),
+	// so the cost takes the stored products instead of the counter sizes to match the written circuit
+	float counter_cost = 0;
+	for (const vector<int>& ids : _products_computed) counter_cost += ids.size() * _config.getCostToffoli();
+	_optimized_cost += counter_cost - model_counter_cost;
 }
 
 /* ===== Function Description:
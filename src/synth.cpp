@@ -0,0 +1,915 @@
+#include "headers.h"
+
+/*
+	Clifford+T approximations of z-rotations, after [N. J. Ross and P. Selinger, "Optimal ancilla-free Clifford+T approximation of z-rotations"]:
+
+	A Clifford+T approximation of rz(theta) within the distance epsilon is U = [[u, -t^†], [t, u^†]] / √2^k,
+	where u and t are in the ring Z[ω] of ω = e^(iπ/4), u^† u + t^† t = 2^k, and u / √2^k lies in the epsilon-region,
+	i.e., the segment of the unit disk with Re(u z^*) >= √2^k (1 - epsilon^2 / 2) for z = e^(-i theta / 2).
+	For k = 0, 1, 2, ..., the candidates u are the points of Z[ω] in the scaled epsilon-region whose conjugates u^• (√2 -> -√2) lie in the disk of radius √2^k.
+	They are enumerated as the lattice points of Z[ω] (embedded as (u, u^•) into R^4) in an ellipsoid around the two regions, over an LLL-reduced basis,
+	which takes the place of the grid operators of the paper.
+	The first candidate for which t^† t = 2^k - u^† u has a solution in Z[ω] gives U:
+	the norm of the right-hand side is factored, and its primes are split in Z[√2] and Z[ω].
+	Then U is decomposed exactly into H and T gates [V. Kliuchnikov et al., "Fast and efficient exact synthesis of single qubit unitaries generated by Clifford and T gates"],
+	multiplying by H T^j to lower the denominator exponent of |u|^2 one at a time, and looking up the remaining unitary in a table of short words.
+*/
+
+typedef __int128 Int;
+typedef unsigned __int128 UInt;
+#ifdef __SIZEOF_FLOAT128__
+typedef __float128 Real;	// the epsilon-regions are 1/epsilon^2 times thinner than the disk, beyond the precision of long double
+#else
+typedef long double Real;
+#endif
+
+const Real REAL_PI = (Real)M_PI + (Real)1.2246467991473532e-16;		// pi as a double-double
+const Real REAL_SQRT2 = (Real)M_SQRT2 - (Real)9.6672933134529135e-17;	// √2 as a double-double
+
+const int SYNTHESIS_QUANTUM_BITS = 8;				// the angles are quantized in units of 2 * pi / 2^(precision + 8)
+const int SYNTHESIS_MAX_POINTS = 1 << 16;			// lattice points enumerated for each denominator exponent
+const UInt SYNTHESIS_MAX_NORM = (UInt)1 << 62;		// norms of the norm equations that are factored
+const int SYNTHESIS_MAX_RHO_STEPS = 1 << 20;		// steps of Pollard's rho method for each factor
+
+Real realSqrt(Real x) {
+	if (x <= 0) return 0;
+	Real y = sqrtl((long double)x);
+	for (int i = 0; i < 3; ++i) y = (y + x / y) / 2;
+	return y;
+}
+
+/* ===== Function Description:
+	Compute cos(x) and sin(x) in the precision of 'Real' by the Taylor series after reducing x into [-pi, pi].
+*/
+void realCosSin(Real x, Real& c, Real& s) {
+	Real turns = x / (2 * REAL_PI);
+	Int n = (Int)(turns < 0 ? turns - (Real)0.5 : turns + (Real)0.5);
+	x -= 2 * REAL_PI * (Real)n;
+	c = 0;
+	s = 0;
+	Real term = 1;
+	for (int i = 0; i < 80; ++i) {		// term = x^i / i!
+		if (i % 4 == 0) c += term;
+		else if (i % 4 == 1) s += term;
+		else if (i % 4 == 2) c -= term;
+		else s -= term;
+		term = term * x / (i + 1);
+	}
+}
+
+Int floorReal(Real x) {
+	Int i = (Int)x;
+	if ((Real)i > x) i--;
+	return i;
+}
+
+Int roundReal(Real x) {
+	return floorReal(x + (Real)0.5);
+}
+
+/* ===== Function Description:
+	Round a / b to the nearest integer (b != 0).
+*/
+Int roundDiv(Int a, Int b) {
+	if (b < 0) {
+		a = -a;
+		b = -b;
+	}
+	Int n = 2 * a + b;		// floor((2a + b) / 2b)
+	Int q = n / (2 * b);
+	if (n % (2 * b) != 0 && n < 0) q--;
+	return q;
+}
+
+/* ===== Function Description:
+	Compare x^2 with y^2 * factor by 256-bit products. Return -1, 0, or 1.
+*/
+int compareSquares(UInt x, UInt y, int factor) {
+	auto square = [](UInt v, UInt& hi, UInt& lo) {
+		UInt v0 = (unsigned long long)v, v1 = v >> 64;
+		UInt p00 = v0 * v0, p01 = v0 * v1, p11 = v1 * v1;
+		UInt mid = (p00 >> 64) + 2 * (UInt)(unsigned long long)p01;
+		lo = (mid << 64) | (unsigned long long)p00;
+		hi = p11 + 2 * (p01 >> 64) + (mid >> 64);
+	};
+	UInt x_hi, x_lo, y_hi, y_lo;
+	square(x, x_hi, x_lo);
+	square(y, y_hi, y_lo);
+	for (int i = 1; i < factor; i *= 2) {		// factor is a power of 2
+		y_hi = (y_hi << 1) | (y_lo >> 127);
+		y_lo <<= 1;
+	}
+	if (x_hi != y_hi) return (x_hi < y_hi) ? -1 : 1;
+	if (x_lo != y_lo) return (x_lo < y_lo) ? -1 : 1;
+	return 0;
+}
+
+class ZRoot2 {		// a + b √2
+public:
+	Int a = 0;
+	Int b = 0;
+	ZRoot2(Int a = 0, Int b = 0) : a(a), b(b) {}
+	ZRoot2 operator+(const ZRoot2& x) const { return ZRoot2(a + x.a, b + x.b); }
+	ZRoot2 operator-(const ZRoot2& x) const { return ZRoot2(a - x.a, b - x.b); }
+	ZRoot2 operator*(const ZRoot2& x) const { return ZRoot2(a * x.a + 2 * b * x.b, a * x.b + b * x.a); }
+	bool operator==(const ZRoot2& x) const { return a == x.a && b == x.b; }
+	bool isZero() const { return a == 0 && b == 0; }
+	ZRoot2 conj() const { return ZRoot2(a, -b); }		// √2 -> -√2
+	Int norm() const { return (Int)((UInt)a * (UInt)a - 2 * (UInt)b * (UInt)b); }	// a^2 - 2 b^2, exact (modulo 2^128) as long as it is small
+	int sign() const {
+		if (a >= 0 && b >= 0) return (a > 0 || b > 0) ? 1 : 0;
+		if (a <= 0 && b <= 0) return -1;
+		int cmp = compareSquares(a < 0 ? -a : a, b < 0 ? -b : b, 2);
+		return (a > 0) ? cmp : -cmp;
+	}
+	long double value() const;
+};
+
+const ZRoot2 LAMBDA(1, 1);			// the fundamental unit 1 + √2
+const ZRoot2 LAMBDA_INV(-1, 1);		// its inverse √2 - 1
+
+/* ===== Function Description:
+	The value in long double, from the conjugate if the terms cancel, as a + b √2 = (a^2 - 2 b^2) / (a - b √2).
+*/
+long double ZRoot2::value() const {
+	long double root2 = sqrtl(2.0L);
+	if ((a >= 0) == (b >= 0)) return (long double)a + (long double)b * root2;
+	return (long double)norm() / ((long double)a - (long double)b * root2);
+}
+
+/* ===== Function Description:
+	Return true with the quotient if y divides x in Z[√2].
+*/
+bool divideRoot2(const ZRoot2& x, const ZRoot2& y, ZRoot2& quotient) {
+	Int n = y.norm();
+	if (n == 0) return false;
+	ZRoot2 p = x * y.conj();
+	if (p.a % n != 0 || p.b % n != 0) return false;
+	quotient = ZRoot2(p.a / n, p.b / n);
+	return true;
+}
+
+/* ===== Function Description:
+	The greatest common divisor in Z[√2] (up to a unit) by the Euclidean algorithm with rounded quotients.
+*/
+ZRoot2 gcdRoot2(ZRoot2 x, ZRoot2 y) {
+	for (int i = 0; i < 256 && !y.isZero(); ++i) {
+		Int n = y.norm();
+		ZRoot2 p = x * y.conj();
+		ZRoot2 r = x - y * ZRoot2(roundDiv(p.a, n), roundDiv(p.b, n));
+		x = y;
+		y = r;
+	}
+	return x;
+}
+
+class ZOmega {		// c[0] + c[1] ω + c[2] ω^2 + c[3] ω^3, where ω^4 = -1
+public:
+	Int c[4] = {0, 0, 0, 0};
+	ZOmega(Int c0 = 0, Int c1 = 0, Int c2 = 0, Int c3 = 0) : c{c0, c1, c2, c3} {}
+	ZOmega(const ZRoot2& x) : c{x.a, x.b, 0, -x.b} {}		// √2 = ω - ω^3
+	ZOmega operator+(const ZOmega& x) const { return ZOmega(c[0] + x.c[0], c[1] + x.c[1], c[2] + x.c[2], c[3] + x.c[3]); }
+	ZOmega operator-(const ZOmega& x) const { return ZOmega(c[0] - x.c[0], c[1] - x.c[1], c[2] - x.c[2], c[3] - x.c[3]); }
+	ZOmega operator*(const ZOmega& x) const {
+		ZOmega product;
+		for (int i = 0; i < 4; ++i) {
+			for (int j = 0; j < 4; ++j) {
+				if (i + j < 4)	product.c[i + j] += c[i] * x.c[j];
+				else			product.c[i + j - 4] -= c[i] * x.c[j];
+			}
+		}
+		return product;
+	}
+	bool operator==(const ZOmega& x) const { return c[0] == x.c[0] && c[1] == x.c[1] && c[2] == x.c[2] && c[3] == x.c[3]; }
+	bool isZero() const { return c[0] == 0 && c[1] == 0 && c[2] == 0 && c[3] == 0; }
+	ZOmega adj() const { return ZOmega(c[0], -c[3], -c[2], -c[1]); }		// complex conjugate
+	ZOmega conj() const { return ZOmega(c[0], -c[1], c[2], -c[3]); }		// √2 -> -√2
+	ZOmega timesOmega(int j) const {		// times ω^j
+		ZOmega x = *this;
+		for (j = ((j % 8) + 8) % 8; j > 0; --j) x = ZOmega(-x.c[3], x.c[0], x.c[1], x.c[2]);
+		return x;
+	}
+	ZRoot2 normSquare() const {		// x^† x
+		ZOmega p = adj() * (*this);
+		return ZRoot2(p.c[0], p.c[1]);
+	}
+	Int norm() const { return normSquare().norm(); }		// the product of the four conjugates
+	bool isDivisibleRoot2() const { return (c[0] - c[2]) % 2 == 0 && (c[1] - c[3]) % 2 == 0; }
+	ZOmega divRoot2() const { return ZOmega((c[1] - c[3]) / 2, (c[0] + c[2]) / 2, (c[1] + c[3]) / 2, (c[2] - c[0]) / 2); }		// x √2 / 2
+	void toComplex(long double& re, long double& im) const {
+		long double half = sqrtl(0.5L);
+		re = (long double)c[0] + (long double)(c[1] - c[3]) * half;
+		im = (long double)c[2] + (long double)(c[1] + c[3]) * half;
+	}
+};
+
+const ZOmega DELTA(1, 1, 0, 0);		// 1 + ω, where DELTA^† DELTA = √2 LAMBDA
+
+/* ===== Function Description:
+	The greatest common divisor in Z[ω] (up to a unit) by the Euclidean algorithm with rounded quotients.
+*/
+ZOmega gcdOmega(ZOmega x, ZOmega y) {
+	for (int i = 0; i < 256 && !y.isZero(); ++i) {
+		ZOmega y_rest = y.adj() * y.conj() * y.conj().adj();		// y * y_rest is the norm of y
+		Int n = y.norm();
+		ZOmega p = x * y_rest;
+		ZOmega r = x - y * ZOmega(roundDiv(p.c[0], n), roundDiv(p.c[1], n), roundDiv(p.c[2], n), roundDiv(p.c[3], n));
+		x = y;
+		y = r;
+	}
+	return x;
+}
+
+/* ===== Function Description:
+	Multiply x by the real unit LAMBDA^j so that |x| and |x^•| are balanced, which keeps the coefficients small.
+*/
+ZOmega balanceOmega(ZOmega x) {
+	long double re, im, conj_re, conj_im;
+	x.toComplex(re, im);
+	x.conj().toComplex(conj_re, conj_im);
+	long double size = hypotl(re, im), conj_size = hypotl(conj_re, conj_im);
+	if (size == 0 || conj_size == 0) return x;
+	long long j = llroundl(logl(conj_size / size) / (2 * logl(1 + sqrtl(2.0L))));
+	for (; j > 0; --j) x = x * ZOmega(LAMBDA);
+	for (; j < 0; ++j) x = x * ZOmega(LAMBDA_INV);
+	return x;
+}
+
+/* ---------- arithmetic modulo a 64-bit integer ---------- */
+
+typedef unsigned long long u64;
+
+u64 mulMod(u64 a, u64 b, u64 m) {
+	return (u64)((UInt)a * b % m);
+}
+
+u64 powMod(u64 a, u64 e, u64 m) {
+	u64 result = 1 % m;
+	for (a %= m; e > 0; e >>= 1) {
+		if (e & 1) result = mulMod(result, a, m);
+		a = mulMod(a, a, m);
+	}
+	return result;
+}
+
+/* ===== Function Description:
+	Miller-Rabin test with the bases that are deterministic for 64-bit integers.
+*/
+bool isPrime(u64 n) {
+	if (n < 2) return false;
+	for (u64 p : {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37}) {
+		if (n % p == 0) return n == p;
+	}
+	u64 d = n - 1;
+	int s = 0;
+	for (; d % 2 == 0; d /= 2) s++;
+	for (u64 a : {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37}) {
+		u64 x = powMod(a, d, n);
+		if (x == 1 || x == n - 1) continue;
+		bool is_witness = true;
+		for (int i = 1; i < s && is_witness; ++i) {
+			x = mulMod(x, x, n);
+			if (x == n - 1) is_witness = false;
+		}
+		if (is_witness) return false;
+	}
+	return true;
+}
+
+/* ===== Function Description:
+	Find a nontrivial factor of the odd composite n by Pollard's rho method (Brent's variant).
+	Return 0 if none is found within the step limit.
+*/
+u64 findFactor(u64 n) {
+	for (u64 c = 1; c < 16; ++c) {
+		u64 x = 2, y = 2, q = 1, g = 1, ys = 2;
+		auto f = [&](u64 v) { return (mulMod(v, v, n) + c) % n; };
+		long long steps = 0;
+		for (u64 r = 1; g == 1 && steps < SYNTHESIS_MAX_RHO_STEPS; r *= 2) {
+			x = y;
+			for (u64 i = 0; i < r; ++i) y = f(y);
+			for (u64 k = 0; k < r && g == 1; k += 128) {
+				ys = y;
+				for (u64 i = 0; i < min((u64)128, r - k); ++i) {
+					y = f(y);
+					q = mulMod(q, (x > y) ? x - y : y - x, n);
+				}
+				g = __gcd(q, n);
+				steps += 128;
+			}
+		}
+		if (g == n) {		// backtrack one step at a time
+			do {
+				ys = f(ys);
+				g = __gcd((x > ys) ? x - ys : ys - x, n);
+			} while (g == 1);
+		}
+		if (g != 1 && g != n) return g;
+	}
+	return 0;
+}
+
+/* ===== Function Description:
+	Factor n into primes with their multiplicities. Return false if a factor cannot be found.
+*/
+bool factorize(u64 n, map<u64, int>& factors) {
+	for (u64 p = 2; p < 1000 && p * p <= n; ++p) {
+		for (; n % p == 0; n /= p) factors[p]++;
+	}
+	vector<u64> stack;
+	if (n > 1) stack.emplace_back(n);
+	while (!stack.empty()) {
+		u64 m = stack.back();
+		stack.pop_back();
+		if (isPrime(m)) {
+			factors[m]++;
+			continue;
+		}
+		u64 d = findFactor(m);
+		if (d == 0) return false;
+		stack.emplace_back(d);
+		stack.emplace_back(m / d);
+	}
+	return true;
+}
+
+/* ===== Function Description:
+	A square root of a modulo the odd prime p by the Tonelli-Shanks algorithm, assuming a is a quadratic residue.
+*/
+u64 sqrtMod(u64 a, u64 p) {
+	a %= p;
+	if (a == 0) return 0;
+	u64 q = p - 1;
+	int s = 0;
+	for (; q % 2 == 0; q /= 2) s++;
+	u64 z = 2;
+	while (powMod(z, (p - 1) / 2, p) != p - 1) z++;
+	u64 m = s, c = powMod(z, q, p), t = powMod(a, q, p), r = powMod(a, (q + 1) / 2, p);
+	while (t != 1) {
+		u64 i = 0;
+		for (u64 t2 = t; t2 != 1 && i < m; ++i) t2 = mulMod(t2, t2, p);
+		u64 b = c;
+		for (u64 j = 0; j + i + 1 < m; ++j) b = mulMod(b, b, p);
+		m = i;
+		c = mulMod(b, b, p);
+		t = mulMod(t, c, p);
+		r = mulMod(r, b, p);
+	}
+	return r;
+}
+
+u64 isqrt(u64 n) {
+	u64 r = (u64)sqrtl((long double)n);
+	while (r > 0 && (UInt)r * r > n) r--;
+	while ((UInt)(r + 1) * (r + 1) <= n) r++;
+	return r;
+}
+
+/* ===== Function Description:
+	Solve x^2 + d y^2 = p for the prime p by Cornacchia's algorithm. Return false if there is no solution.
+*/
+bool cornacchia(u64 p, u64 d, u64& x, u64& y) {
+	if (powMod(p - d % p, (p - 1) / 2, p) != 1) return false;
+	u64 a = p, b = sqrtMod(p - d % p, p);
+	if (b <= p / 2) b = p - b;
+	while ((UInt)b * b > p) {
+		u64 r = a % b;
+		a = b;
+		b = r;
+	}
+	if ((p - b * b) % d != 0) return false;
+	x = b;
+	y = isqrt((p - b * b) / d);
+	return (UInt)x * x + (UInt)d * y * y == p;
+}
+
+/* ===== Function Description:
+	Solve t^† t = xi in Z[ω] for a nonnegative xi in Z[√2] with a nonnegative conjugate.
+	Return false if there is no solution or the norm of xi cannot be factored.
+*/
+bool solveNormEquation(ZRoot2 xi, ZOmega& t) {
+	if (xi.isZero()) {
+		t = ZOmega();
+		return true;
+	}
+	if (xi.sign() < 0 || xi.conj().sign() < 0) return false;
+
+	// xi = LAMBDA^(2 m) xi', where xi' is balanced, and t = LAMBDA^m t'
+	long double size = xi.value(), conj_size = xi.conj().value();
+	long long m = llroundl(logl(size / conj_size) / (4 * logl(1 + sqrtl(2.0L))));
+	ZRoot2 balanced = xi;
+	for (long long i = 0; i < m; ++i) balanced = balanced * LAMBDA_INV * LAMBDA_INV;
+	for (long long i = 0; i > m; --i) balanced = balanced * LAMBDA * LAMBDA;
+	Int n = balanced.norm();
+	if (n <= 0 || (UInt)n >= SYNTHESIS_MAX_NORM) return false;
+
+	ZOmega solution(1);
+	ZRoot2 rest = balanced;
+	while (rest.a % 2 == 0) {		// √2 = DELTA^† DELTA LAMBDA^-1
+		rest = ZRoot2(rest.b, rest.a / 2);
+		solution = solution * DELTA;
+	}
+	map<u64, int> factors;
+	Int rest_norm = rest.norm();
+	if (!factorize((u64)(rest_norm < 0 ? -rest_norm : rest_norm), factors)) return false;
+	for (auto& factor : factors) {
+		u64 p = factor.first;
+		int e = factor.second;
+		u64 x, y;
+		if (p % 8 == 3 || p % 8 == 5) {		// p is a prime of Z[√2], and p = x^2 + d y^2 = π^† π
+			if (e % 2 != 0 || !cornacchia(p, (p % 8 == 3) ? 2 : 1, x, y)) return false;
+			ZOmega pi = (p % 8 == 3) ? ZOmega(x, y, 0, y) : ZOmega(x, 0, y, 0);		// x + y √-2 or x + y i
+			for (int i = 0; i < e / 2; ++i) solution = balanceOmega(solution * pi);
+			continue;
+		}
+
+		// p = η η^• in Z[√2], where η = gcd(p, s + √2) for s^2 = 2 (mod p)
+		ZRoot2 eta = gcdRoot2(ZRoot2(p, 0), ZRoot2(sqrtMod(2, p), 1));
+		Int eta_norm = eta.norm();
+		if (eta_norm != (Int)p && eta_norm != -(Int)p) return false;
+		int e_eta = 0;
+		for (ZRoot2 quotient; e_eta < e && divideRoot2(rest, eta, quotient); ++e_eta) rest = quotient;
+		int e_conj = e - e_eta;
+		if (p % 8 == 7) {		// η is also a prime of Z[ω], so its multiplicities must be even
+			if (e_eta % 2 != 0 || e_conj % 2 != 0) return false;
+			for (int i = 0; i < e_eta / 2; ++i) solution = balanceOmega(solution * ZOmega(eta));
+			for (int i = 0; i < e_conj / 2; ++i) solution = balanceOmega(solution * ZOmega(eta.conj()));
+			continue;
+		}
+
+		// η = π^† π up to a unit, where π = gcd(η, x + y i) for p = x^2 + y^2
+		if (!cornacchia(p, 1, x, y)) return false;
+		ZOmega pi = gcdOmega(ZOmega(eta), ZOmega(x, 0, y, 0));
+		if (pi.norm() != (Int)p) return false;
+		for (int i = 0; i < e_eta; ++i) solution = balanceOmega(solution * pi);
+		for (int i = 0; i < e_conj; ++i) solution = balanceOmega(solution * pi.conj());
+	}
+
+	// balanced = u solution^† solution for a positive unit u of Z[√2] with a positive conjugate, i.e., u = LAMBDA^(2 j)
+	ZRoot2 unit;
+	if (!divideRoot2(balanced, solution.normSquare(), unit) || unit.sign() <= 0 || unit.conj().sign() <= 0) return false;
+	long long j = llroundl(logl(unit.value()) / (2 * logl(1 + sqrtl(2.0L))));
+	for (long long i = 0; i < j + m; ++i) solution = solution * ZOmega(LAMBDA);
+	for (long long i = 0; i > j + m; --i) solution = solution * ZOmega(LAMBDA_INV);
+	if (!(solution.normSquare() == xi)) return false;
+	t = solution;
+	return true;
+}
+
+/* ===== Function Description:
+	Enumerate the candidates u in Z[ω] for the denominator exponent k, i.e., u / √2^k in the epsilon-region of z = (cos_phi, sin_phi)
+	and |u^•| <= √2^k, until 'visit' returns true. Return true if it does.
+	The coordinates of the lattice points are scaled so that an ellipsoid of radius √3 covers both regions,
+	and the points in the ellipsoid are enumerated by Fincke-Pohst over an LLL-reduced basis.
+	The scaled lattice only shrinks by √2 with k, so the reduced basis 'transform' (rows in the coefficients of Z[ω]) is kept for the next k.
+*/
+bool enumerateCandidates(int k, Real cos_phi, Real sin_phi, Real epsilon, Int (&transform)[4][4], const function<bool(const ZOmega&)>& visit) {
+	Real s = 1;
+	for (int i = 0; i < k; ++i) s *= REAL_SQRT2;
+	Real h = s * epsilon * epsilon / 4;		// half the depth of the epsilon-region
+	Real w = s * epsilon;					// bound of half its width
+	Real center = s - h;
+	Real bound = s * (1 - epsilon * epsilon / 2);
+
+	// rows: (Re(u z^*) - center) / h, Im(u z^*) / w, Re(u^•) / s, and Im(u^•) / s for the basis ω^j of Z[ω]
+	Real half = REAL_SQRT2 / 2;
+	Real basis_re[4] = {1, half, 0, -half};
+	Real basis_im[4] = {0, half, 1, half};
+	Real embedding[4][4];
+	for (int j = 0; j < 4; ++j) {
+		Real sign = (j % 2 == 0) ? 1 : -1;		// ω^• = -ω
+		embedding[0][j] = (basis_re[j] * cos_phi + basis_im[j] * sin_phi) / h;
+		embedding[1][j] = (basis_im[j] * cos_phi - basis_re[j] * sin_phi) / w;
+		embedding[2][j] = sign * basis_re[j] / s;
+		embedding[3][j] = sign * basis_im[j] / s;
+	}
+	Real target[4] = {center / h, 0, 0, 0};
+
+	Real vectors[4][4], stars[4][4], mu[4][4], norms[4];
+	auto setVector = [&](int i) {
+		for (int r = 0; r < 4; ++r) {
+			vectors[i][r] = 0;
+			for (int j = 0; j < 4; ++j) vectors[i][r] += embedding[r][j] * (Real)transform[i][j];
+		}
+	};
+	auto gramSchmidt = [&]() {
+		for (int i = 0; i < 4; ++i) {
+			for (int r = 0; r < 4; ++r) stars[i][r] = vectors[i][r];
+			for (int j = 0; j < i; ++j) {
+				Real dot = 0;
+				for (int r = 0; r < 4; ++r) dot += vectors[i][r] * stars[j][r];
+				mu[i][j] = dot / norms[j];
+				for (int r = 0; r < 4; ++r) stars[i][r] -= mu[i][j] * stars[j][r];
+			}
+			norms[i] = 0;
+			for (int r = 0; r < 4; ++r) norms[i] += stars[i][r] * stars[i][r];
+		}
+	};
+	for (int i = 0; i < 4; ++i) setVector(i);
+
+	// LLL reduction with delta = 0.99
+	int i = 1;
+	for (int iteration = 0; i < 4 && iteration < 100000; ++iteration) {
+		for (int j = i - 1; j >= 0; --j) {
+			gramSchmidt();
+			Int q = roundReal(mu[i][j]);
+			if (q == 0) continue;
+			for (int c = 0; c < 4; ++c) transform[i][c] -= q * transform[j][c];
+			setVector(i);
+		}
+		gramSchmidt();
+		if (norms[i] >= ((Real)0.99 - mu[i][i - 1] * mu[i][i - 1]) * norms[i - 1]) {
+			i++;
+			continue;
+		}
+		swap(transform[i], transform[i - 1]);
+		setVector(i);
+		setVector(i - 1);
+		i = max(i - 1, 1);
+	}
+	gramSchmidt();
+
+	// the target in the Gram-Schmidt coordinates
+	Real target_coords[4];
+	auto setTargetCoords = [&]() {
+		for (int j = 0; j < 4; ++j) {
+			Real dot = 0;
+			for (int r = 0; r < 4; ++r) dot += target[r] * stars[j][r];
+			target_coords[j] = dot / norms[j];
+		}
+	};
+	setTargetCoords();
+
+	// The coefficients of the target in the reduced basis are huge, and so are the errors of their combinations,
+	// so the points are enumerated around the nearest plane point 'origin', with the target moved by its embedding from the exact coefficients.
+	Int origin_coeffs[4];
+	for (int level = 3; level >= 0; --level) {
+		Real c = target_coords[level];
+		for (int j = level + 1; j < 4; ++j) c -= (Real)origin_coeffs[j] * mu[j][level];
+		origin_coeffs[level] = roundReal(c);
+	}
+	ZOmega origin;
+	for (int j = 0; j < 4; ++j) {
+		for (int c = 0; c < 4; ++c) origin.c[c] += origin_coeffs[j] * transform[j][c];
+	}
+	for (int r = 0; r < 4; ++r) {
+		for (int j = 0; j < 4; ++j) target[r] -= embedding[r][j] * (Real)origin.c[j];
+	}
+	setTargetCoords();
+
+	const Real radius = 3;
+	Int x[4];
+	int n_points = 0;
+	function<bool(int, Real)> search = [&](int level, Real remaining) -> bool {
+		Real c = target_coords[level];
+		for (int j = level + 1; j < 4; ++j) c -= (Real)x[j] * mu[j][level];
+		Real spread = realSqrt(remaining / norms[level]);
+		for (Int v = floorReal(c - spread); (Real)v <= c + spread; ++v) {
+			Real d = ((Real)v - c) * ((Real)v - c) * norms[level];
+			if (d > remaining) continue;
+			x[level] = v;
+			if (level > 0) {
+				if (search(level - 1, remaining - d)) return true;
+				continue;
+			}
+			if (++n_points > SYNTHESIS_MAX_POINTS) return true;
+
+			ZOmega u = origin;
+			for (int j = 0; j < 4; ++j) {
+				for (int c2 = 0; c2 < 4; ++c2) u.c[c2] += x[j] * transform[j][c2];
+			}
+			Real re = (Real)u.c[0] + (Real)(u.c[1] - u.c[3]) * half;
+			Real im = (Real)u.c[2] + (Real)(u.c[1] + u.c[3]) * half;
+			if (re * cos_phi + im * sin_phi < bound) continue;
+			if (visit(u)) return true;
+		}
+		return false;
+	};
+	return search(3, radius) && n_points <= SYNTHESIS_MAX_POINTS;
+}
+
+/* ---------- exact synthesis ---------- */
+
+class Column {		// a column (x, y) / √2^k of a unitary over Z[ω, 1/√2]
+public:
+	ZOmega x;
+	ZOmega y;
+	int k = 0;
+	void normalize() {
+		while (k > 0 && x.isDivisibleRoot2() && y.isDivisibleRoot2()) {
+			x = x.divRoot2();
+			y = y.divRoot2();
+			k--;
+		}
+	}
+	void applyT(int j) { y = y.timesOmega(j); }
+	void applyH() {
+		ZOmega sum = x + y;
+		y = x - y;
+		x = sum;
+		k++;
+		normalize();
+	}
+	int sde() const {		// the smallest denominator exponent of |x|^2 over √2
+		ZRoot2 n = x.normSquare();
+		if (n.isZero()) return -1;
+		int e = 2 * k;
+		while (n.a % 2 == 0) {
+			n = ZRoot2(n.b, n.a / 2);
+			e--;
+		}
+		return e;
+	}
+	Column timesOmega(int j) const {
+		Column column = *this;
+		column.x = x.timesOmega(j);
+		column.y = y.timesOmega(j);
+		return column;
+	}
+	bool operator==(const Column& column) const { return k == column.k && x == column.x && y == column.y; }
+	array<long long, 9> key() const {		// the same for the columns equal up to a power of ω
+		array<long long, 9> best;
+		for (int j = 0; j < 8; ++j) {
+			Column column = timesOmega(j);
+			array<long long, 9> key = {(long long)column.x.c[0], (long long)column.x.c[1], (long long)column.x.c[2], (long long)column.x.c[3],
+				(long long)column.y.c[0], (long long)column.y.c[1], (long long)column.y.c[2], (long long)column.y.c[3], k};
+			if (j == 0 || key < best) best = key;
+		}
+		return best;
+	}
+};
+
+const int TOKEN_H = -1;		// a token is H or a power of T
+
+class BaseWord {	// a short word of H and T gates (in time order) and the columns of its unitary
+public:
+	vector<int> tokens;
+	Column first;
+	Column second;
+};
+
+/* ===== Function Description:
+	The words of the unitaries whose first column has an sde of |x|^2 of at most 4, found by a breadth-first search over H and T,
+	keyed by the first column up to a power of ω.
+*/
+const map<array<long long, 9>, BaseWord>& baseWords() {
+	static const map<array<long long, 9>, BaseWord> words = []() {
+		map<array<long long, 9>, BaseWord> words;
+		BaseWord identity;
+		identity.first.x = ZOmega(1);
+		identity.second.y = ZOmega(1);
+		words[identity.first.key()] = identity;
+		deque<BaseWord> queue = {identity};
+		while (!queue.empty()) {
+			BaseWord word = queue.front();
+			queue.pop_front();
+			for (int token : {TOKEN_H, 1}) {
+				BaseWord next = word;
+				next.tokens.emplace_back(token);
+				if (token == TOKEN_H) {
+					next.first.applyH();
+					next.second.applyH();
+				}
+				else {
+					next.first.applyT(token);
+					next.second.applyT(token);
+				}
+				if (next.first.sde() > 4 || words.count(next.first.key())) continue;
+				words[next.first.key()] = next;
+				queue.emplace_back(next);
+			}
+		}
+		return words;
+	}();
+	return words;
+}
+
+/* ===== Function Description:
+	Decompose the unitary [[u, -t^†], [t, u^†]] / √2^k into H and powers of T (in time order), up to a global phase.
+	Return false if the remaining unitary is not found.
+*/
+bool exactSynthesis(const ZOmega& u, const ZOmega& t, int k, vector<int>& tokens) {
+	Column first, second;
+	first.x = u;
+	first.y = t;
+	first.k = k;
+	second.x = ZOmega() - t.adj();
+	second.y = u.adj();
+	second.k = k;
+	first.normalize();
+	second.normalize();
+
+	vector<int> steps;		// U = T^-j_1 H T^-j_2 H ... U'
+	for (int iteration = 0; first.sde() > 4 && iteration < 10000; ++iteration) {
+		int best_j = -1, best_sde = INT_MAX;
+		for (int j = 0; j < 4; ++j) {
+			Column next = first;
+			next.applyT(j);
+			next.applyH();
+			if (next.sde() < best_sde) {
+				best_sde = next.sde();
+				best_j = j;
+			}
+		}
+		if (best_sde >= first.sde()) return false;
+		first.applyT(best_j);
+		first.applyH();
+		second.applyT(best_j);
+		second.applyH();
+		steps.emplace_back(best_j);
+	}
+
+	auto found = baseWords().find(first.key());
+	if (found == baseWords().end()) return false;
+	const BaseWord& word = found->second;
+	int a = -1, b = -1;		// U' = W diag(ω^a, ω^b)
+	for (int j = 0; j < 8; ++j) {
+		if (word.first.timesOmega(j) == first) a = j;
+		if (word.second.timesOmega(j) == second) b = j;
+	}
+	if (a == -1 || b == -1) return false;
+
+	tokens.clear();
+	tokens.emplace_back(((b - a) % 8 + 8) % 8);
+	tokens.insert(tokens.end(), word.tokens.begin(), word.tokens.end());
+	for (int i = steps.size() - 1; i >= 0; --i) {
+		tokens.emplace_back(TOKEN_H);
+		tokens.emplace_back((8 - steps[i]) % 8);
+	}
+
+	// merge the powers of T and cancel the pairs of H
+	vector<int> merged;
+	for (int token : tokens) {
+		if (token == TOKEN_H && !merged.empty() && merged.back() == TOKEN_H) merged.pop_back();
+		else if (token != TOKEN_H && !merged.empty() && merged.back() != TOKEN_H) merged.back() = (merged.back() + token) % 8;
+		else merged.emplace_back(token);
+		if (!merged.empty() && merged.back() == 0) merged.pop_back();
+	}
+	tokens = merged;
+	return true;
+}
+
+/* ===== Function Description:
+	The operator-norm distance between the tokens and rz(theta) up to a global phase, i.e., sqrt(2 - |tr(U^† rz(theta))|).
+*/
+Real tokenDistance(const vector<int>& tokens, Real theta) {
+	Real m_re[2][2] = {{1, 0}, {0, 1}}, m_im[2][2] = {{0, 0}, {0, 0}};
+	Real half = REAL_SQRT2 / 2;
+	for (int token : tokens) {
+		if (token == TOKEN_H) {
+			for (int c = 0; c < 2; ++c) {
+				Real re0 = m_re[0][c], im0 = m_im[0][c], re1 = m_re[1][c], im1 = m_im[1][c];
+				m_re[0][c] = (re0 + re1) * half;
+				m_im[0][c] = (im0 + im1) * half;
+				m_re[1][c] = (re0 - re1) * half;
+				m_im[1][c] = (im0 - im1) * half;
+			}
+			continue;
+		}
+		Real w_re, w_im;
+		realCosSin(REAL_PI * token / 4, w_re, w_im);
+		for (int c = 0; c < 2; ++c) {
+			Real re = m_re[1][c], im = m_im[1][c];
+			m_re[1][c] = re * w_re - im * w_im;
+			m_im[1][c] = re * w_im + im * w_re;
+		}
+	}
+	Real z_re, z_im;		// rz(theta) = diag(z^*, z) for z = e^(i theta / 2)
+	realCosSin(theta / 2, z_re, z_im);
+	Real tr_re = m_re[0][0] * z_re - m_im[0][0] * z_im + m_re[1][1] * z_re + m_im[1][1] * z_im;		// tr(M^† rz) = M00^* z^* + M11^* z
+	Real tr_im = m_re[1][1] * z_im - m_im[1][1] * z_re - m_re[0][0] * z_im - m_im[0][0] * z_re;
+	Real distance_square = 2 - realSqrt(tr_re * tr_re + tr_im * tr_im);
+	return realSqrt(distance_square < 0 ? 0 : distance_square);
+}
+
+/* ===== Function Description:
+	Synthesize rz(theta) within the distance epsilon into H and powers of T (in time order).
+	A power of T within the distance is taken as it is. Otherwise, the search starts at the denominator exponent k
+	where the ellipsoid is expected to hold 1/256 of a lattice point (9 pi^2 / 32 * 4^k * epsilon^3), since the lattices before are too skewed for the precision.
+	Return false if no approximation is found.
+*/
+bool synthesizeRotation(Real theta, Real epsilon, vector<int>& tokens) {
+	for (int j = 0; j < 8; ++j) {
+		tokens = {j};
+		if (tokenDistance(tokens, theta) <= epsilon) return true;
+	}
+
+	Real cos_phi, sin_phi;		// z = e^(-i theta / 2)
+	realCosSin(-theta / 2, cos_phi, sin_phi);
+	double log_epsilon = log2((double)epsilon);
+	int min_k = max(0, (int)ceil((-8 - log2(9 * M_PI * M_PI / 32) - 3 * log_epsilon) / 2));
+	int max_k = min(120, min_k + 2 * (int)ceil(-log_epsilon) + 40);
+	Int transform[4][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+	for (int k = min_k; k <= max_k; ++k) {
+		ZOmega u, t;
+		Int power = (Int)1 << k;
+		bool is_found = enumerateCandidates(k, cos_phi, sin_phi, epsilon, transform, [&](const ZOmega& candidate) {
+			ZRoot2 xi = ZRoot2(power, 0) - candidate.normSquare();
+			if (!solveNormEquation(xi, t)) return false;
+			u = candidate;
+			return true;
+		});
+		if (!is_found) continue;
+		if (exactSynthesis(u, t, k, tokens) && tokenDistance(tokens, theta) <= epsilon) return true;
+	}
+	return false;
+}
+
+/* ===== Function Description:
+	Parse a rotation line "rz(angle) qubit;" or "p(angle) qubit;" of a written circuit.
+*/
+bool parseRotationLine(const string& line, double& angle, string& qubit) {
+	size_t begin = line.find_first_not_of(" \t");
+	if (begin == string::npos || (line.compare(begin, 3, "rz(") != 0 && line.compare(begin, 2, "p(") != 0)) return false;
+	size_t open = line.find('(', begin), close = line.find(')', open), end = line.find(';', close);
+	if (close == string::npos || end == string::npos) return false;
+	try { angle = stod(line.substr(open + 1, close - open - 1)); }
+	catch (...) { return false; }
+	qubit = line.substr(close + 1, end - close - 1);
+	qubit.erase(remove_if(qubit.begin(), qubit.end(), ::isspace), qubit.end());
+	return !qubit.empty();
+}
+
+/* ===== Function Description:
+	Quantize an angle into units of 2 * pi / 2^(precision + 8), modulo 2 * pi.
+*/
+long long RotationSynthesizer::quantize(double angle) const {
+	long long n_units = 1LL << (_precision + SYNTHESIS_QUANTUM_BITS);
+	long long units = llround(fmod(angle / (2 * M_PI), 1.0) * n_units);
+	return ((units % n_units) + n_units) % n_units;
+}
+
+/* ===== Function Description:
+	Add the distinct angles of the rotation lines of a circuit as jobs.
+*/
+void RotationSynthesizer::collect(const string& circuit) {
+	stringstream circuit_ss(circuit);
+	string line, qubit;
+	double angle;
+	while (getline(circuit_ss, line)) {
+		if (parseRotationLine(line, angle, qubit)) _sequences[quantize(angle)];
+	}
+}
+
+/* ===== Function Description:
+	Synthesize the collected angles concurrently within the distance 2^-(precision + 1) of each rotation, including the quantization.
+	Multiples of pi/4 are powers of T. Return the number of angles without a sequence.
+*/
+int RotationSynthesizer::synthesize(int n_threads) {
+	vector<long long> jobs;
+	for (auto& entry : _sequences) {
+		if (!entry.second.is_done) jobs.emplace_back(entry.first);
+	}
+	vector<Sequence> results(jobs.size());
+	long long n_units = 1LL << (_precision + SYNTHESIS_QUANTUM_BITS);
+	Real epsilon = ldexpl(1.0L, -(_precision + 1)) * (1 - M_PI / (1 << SYNTHESIS_QUANTUM_BITS));	// the quantization adds at most pi / 2^(precision + 9)
+	parallelFor(jobs.size(), n_threads, [&](int job) {
+		long long units = jobs[job];
+		Sequence& sequence = results[job];
+		sequence.is_done = true;
+		vector<int> tokens;
+		if (units % (n_units / 8) == 0)	tokens = {(int)(units / (n_units / 8))};
+		else if (!synthesizeRotation(2 * REAL_PI * (Real)units / (Real)n_units, epsilon, tokens)) return;
+		sequence.is_found = true;
+
+		static const vector<vector<string>> powers = {{}, {"t"}, {"s"}, {"s", "t"}, {"z"}, {"z", "t"}, {"sdg"}, {"tdg"}};
+		for (int token : tokens) {
+			if (token == TOKEN_H) {
+				sequence.gates.emplace_back("h");
+				continue;
+			}
+			sequence.gates.insert(sequence.gates.end(), powers[token].begin(), powers[token].end());
+			sequence.t_count += token % 2;
+		}
+	});
+
+	int n_failed = 0;
+	for (int job = 0; job < jobs.size(); ++job) {
+		_sequences[jobs[job]] = results[job];
+		if (!results[job].is_found) n_failed++;
+	}
+	return n_failed;
+}
+
+/* ===== Function Description:
+	Replace the rotation lines of a circuit by their sequences, adding their T gates to 't_count' and their number to 'n_rotations'.
+	Rotations without a sequence are kept.
+*/
+string RotationSynthesizer::rewrite(const string& circuit, long long& t_count, long long& n_rotations) const {
+	string rewritten;
+	rewritten.reserve(circuit.size());
+	stringstream circuit_ss(circuit);
+	string line, qubit;
+	double angle;
+	while (getline(circuit_ss, line)) {
+		auto found = parseRotationLine(line, angle, qubit) ? _sequences.find(quantize(angle)) : _sequences.end();
+		if (found == _sequences.end() || !found->second.is_found) {
+			rewritten += line + "\n";
+			continue;
+		}
+		for (const string& gate : found->second.gates) rewritten += gate + " " + qubit + ";\n";
+		t_count += found->second.t_count;
+		n_rotations++;
+	}
+	return rewritten;
+}
@@ -0,0 +1,502 @@
+#include "headers.h"
+
+/* ===== Function Description:
+	Constructor of the 'Verifier' class.
+	The expected phases are the exact angles of the gates (see 'angleToTurns'), not their rounded bits,
+	and each gate may be off by its rounding into 'precision' bits or by its tolerated error, whichever is larger.
+	The "frs" register has 'frs_width' bits, which is smaller than 'precision' in the special case.
+*/
+Verifier::Verifier(const vector<GateSpec>& gates, int precision, int frs_width, bool is_same) : _gates(gates), _r(frs_width), _is_same(is_same) {
+	_mask = (_r >= 64) ? ~0ULL : ((1ULL << _r) - 1);
+	for (GateSpec& gate : _gates) {
+		_turns.emplace_back(angleToTurns(gate.angle));
+		long double tolerance = ldexpl(1, -1 - precision);
+		if (gate.max_error >= 0 && !is_same) tolerance = max(tolerance, (long double)(4 * asin(min(gate.max_error, 2.0) / 2) / (2 * M_PI)));
+		_tolerances.emplace_back(tolerance + ldexpl(1, -52));	// and the error of a double
+	}
+}
+
+/* ===== Function Description:
+	Get the wire index of a qubit name (e.g., "anc[3]"), adding it if not found.
+*/
+int Verifier::getWire(const string& name) {
+	auto it = _wire_ids.find(name);
+	if (it != _wire_ids.end()) return it->second;
+	_wire_ids[name] = _wire_names.size();
+	_wire_names.emplace_back(name);
+	return _wire_names.size() - 1;
+}
+
+/* ===== Function Description:
+	Parse the gates of a synthesized block into operations on wires.
+	NOT, CNOT, Toffoli, and multi-controlled NOT gates are simulated, and "rz" gates add phases.
+	The basis changes (h, s, sdg) are kept aside for 'checkBasis', since the data qubits are simulated in the rotated basis.
+	Return false with a message if an unsupported gate is found.
+*/
+bool Verifier::parse(const string& circuit, string& message) {
+	_op_wires.clear();
+	_op_begins.assign(1, 0);
+	_op_phases.clear();
+	_basis_changes.clear();
+
+	stringstream circuit_ss(circuit);
+	string line;
+	while (getline(circuit_ss, line)) {
+		line = line.substr(0, line.find("//"));
+		size_t begin = line.find_first_not_of(" \t\r");
+		if (begin == string::npos) continue;
+		line = line.substr(begin);
+
+		string gate_name = line.substr(0, line.find_first_of(" (\t"));
+		if (gate_name == "barrier") continue;
+		if (gate_name == "h" || gate_name == "s" || gate_name == "sdg") {
+			string operand = line.substr(gate_name.size(), line.find(';') - gate_name.size());
+			operand.erase(remove_if(operand.begin(), operand.end(), ::isspace), operand.end());
+			_basis_changes.emplace_back(getWire(operand), (gate_name == "sdg") ? 'd' : gate_name[0], _op_phases.size());
+			continue;
+		}
+
+		double phase = NAN;
+		if (gate_name == "rz") {
+			phase = stold(line.substr(line.find('(') + 1)) / (2 * M_PIl);		// in turns
+		}
+		else if (gate_name != "x" && gate_name != "cx" && gate_name != "ccx" && gate_name != "mcx") {
+			message = "unsupported gate \"" + gate_name + "\"";
+			return false;
+		}
+
+		size_t pos = (gate_name == "rz") ? line.find(')') + 1 : gate_name.size();
+		string operands = line.substr(pos, line.find(';') - pos);
+		stringstream operands_ss(operands);
+		string operand;
+		while (getline(operands_ss, operand, ',')) {
+			operand.erase(remove_if(operand.begin(), operand.end(), ::isspace), operand.end());
+			_op_wires.emplace_back(getWire(operand));
+		}
+		_op_begins.emplace_back(_op_wires.size());
+		_op_phases.emplace_back(phase);
+	}
+	return true;
+}
+
+/* ===== Function Description:
+	Check the basis changes of the data qubits, where 'axes' is the rotation axis of each data wire (see 'getAxis').
+	On each data qubit, they must come before its first operation or after its last one,
+	the ones before must turn the axis of its gates into +Z (e.g., "h" for an "rx" gate), and the ones after must undo them.
+	A basis change on any other qubit is rejected. Return false with a message if any check fails.
+*/
+bool Verifier::checkBasis(const vector<int>& data_wires, const vector<int>& axes, string& message) {
+	int n_wires = _wire_names.size();
+	vector<int> first_op(n_wires, INT_MAX), last_op(n_wires, -1);
+	for (int i = 0; i + 1 < _op_begins.size(); ++i) {
+		for (int j = _op_begins[i]; j < _op_begins[i + 1]; ++j) {
+			first_op[_op_wires[j]] = min(first_op[_op_wires[j]], i);
+			last_op[_op_wires[j]] = i;
+		}
+	}
+
+	// the images of the Paulis X, Y, Z (0, 1, 2) under the gates so far, as (sign, Pauli)
+	const map<char, array<pair<int, int>, 3>> conjugations = {
+		{ 'h', {{ {1, 2}, {-1, 1}, {1, 0} }} },
+		{ 's', {{ {1, 1}, {-1, 0}, {1, 2} }} },
+		{ 'd', {{ {-1, 1}, {1, 0}, {1, 2} }} },		// "sdg"
+	};
+	for (int k = 0; k < data_wires.size(); ++k) {
+		int wire = data_wires[k];
+		array<pair<int, int>, 3> frame = {{ {1, 0}, {1, 1}, {1, 2} }};
+		bool is_rotated = (last_op[wire] == -1);	// the gates before the first operation are applied (or there is no operation)
+		for (auto& change : _basis_changes) {
+			if (get<0>(change) != wire) continue;
+			int position = get<2>(change);
+			if (position > first_op[wire] && position <= last_op[wire]) {
+				message = "a basis change on " + _wire_names[wire] + " is between its operations";
+				return false;
+			}
+			if (position > last_op[wire] && !is_rotated) {
+				if (frame[axes[k]] != make_pair(1, 2)) break;
+				is_rotated = true;
+			}
+			for (auto& image : frame) {
+				const pair<int, int>& mapped = conjugations.at(get<1>(change))[image.second];
+				image = make_pair(image.first * mapped.first, mapped.second);
+			}
+		}
+		if (!is_rotated && frame[axes[k]] != make_pair(1, 2)) {
+			message = "the gates on " + _wire_names[wire] + " are not rotated into the Z basis";
+			return false;
+		}
+		if (frame[0] != make_pair(1, 0) || frame[2] != make_pair(1, 2)) {
+			message = "the basis of " + _wire_names[wire] + " is not restored";
+			return false;
+		}
+	}
+	for (auto& change : _basis_changes) {
+		if (find(data_wires.begin(), data_wires.end(), get<0>(change)) == data_wires.end()) {
+			message = "a basis change on " + _wire_names[get<0>(change)] + ", which is not a qubit of the gates";
+			return false;
+		}
+	}
+	return true;
+}
+
+/* ===== Function Description:
+	Simulate the operations on 64 inputs at once, where bit k of each word is the k-th input.
+	'phases' accumulates the "rz" phases of each input.
+*/
+void Verifier::simulate(vector<unsigned long long>& state, vector<long double>& phases) {
+	for (int i = 0; i + 1 < _op_begins.size(); ++i) {
+		int begin = _op_begins[i];
+		int target = _op_wires[_op_begins[i + 1] - 1];
+		if (!isnan(_op_phases[i])) {
+			for (unsigned long long word = state[target]; word != 0; word &= word - 1) {
+				phases[__builtin_ctzll(word)] += _op_phases[i];
+			}
+			continue;
+		}
+
+		unsigned long long control = ~0ULL;
+		for (int j = begin; j < _op_begins[i + 1] - 1; ++j) {
+			control &= state[_op_wires[j]];
+		}
+		state[target] ^= control;
+	}
+}
+
+/* ===== Function Description:
+	Check that a synthesized block implements the rotations on 'n_samples' computational-basis inputs.
+	The basis changes of the data qubits are checked by 'checkBasis'.
+	For each input x of the data qubits (in the rotated basis) and a random value of "frs",
+	the value added to "frs" plus the "rz" phases must equal the sum of the angles of the gates g with f_g(x) = 1
+	up to a global phase and within the tolerances of the gates (see the constructor), where f_g is the parity of the qubits (the AND for "cp"),
+	and all the other registers must be restored.
+	All inputs are checked if there are at most 'n_samples' of them; otherwise, they are sampled at random.
+	Return false with a message if any check fails.
+*/
+bool Verifier::verify(const string& circuit, int n_samples, string& message) {
+	if (_r > 64) {
+		message = "the precision is larger than 64 bits";
+		return false;
+	}
+	_wire_ids.clear();
+	_wire_names.clear();
+	if (!parse(circuit, message)) return false;
+
+	// data qubits of the gates
+	vector<vector<int>> gate_wires;
+	vector<int> data_wires, axes;
+	for (GateSpec& gate : _gates) {
+		gate_wires.emplace_back();
+		for (int qubit : gate.qubits) {
+			int wire = getWire("q[" + to_string(qubit) + "]");
+			gate_wires.back().emplace_back(wire);
+			if (find(data_wires.begin(), data_wires.end(), wire) == data_wires.end()) {
+				data_wires.emplace_back(wire);
+				axes.emplace_back(getAxis(gate.type));
+			}
+		}
+	}
+	vector<int> frs_wires(_r);
+	for (int i = 0; i < _r; ++i) {
+		frs_wires[i] = getWire("frs[" + to_string(i) + "]");
+	}
+	int n_wires = _wire_names.size();
+	if (!checkBasis(data_wires, axes, message)) return false;
+
+	bool is_exhaustive = (data_wires.size() < 31 && (1LL << data_wires.size()) <= n_samples);
+	long long n_inputs = is_exhaustive ? (1LL << data_wires.size()) : n_samples;
+	mt19937_64 rng(n_wires * 1000003ULL + _op_wires.size());
+	long double global_phase = 0;		// the phases are compared up to the one of the first input
+	long double global_tolerance = 0;	// with its tolerance
+
+	for (long long first = 0; first < n_inputs; first += 64) {
+		int n_lanes = min(64LL, n_inputs - first);
+		unsigned long long lanes = (n_lanes == 64) ? ~0ULL : ((1ULL << n_lanes) - 1);
+
+		// inputs
+		vector<unsigned long long> state(n_wires, 0);
+		for (int k = 0; k < data_wires.size(); ++k) {
+			if (!is_exhaustive) {
+				state[data_wires[k]] = rng() & lanes;
+				continue;
+			}
+			for (int lane = 0; lane < n_lanes; ++lane) {
+				state[data_wires[k]] |= (((first + lane) >> k) & 1ULL) << lane;
+			}
+		}
+		for (int wire : frs_wires) {
+			state[wire] = rng() & lanes;
+		}
+		vector<unsigned long long> initial = state;
+
+		vector<long double> phases(64, 0);
+		simulate(state, phases);
+
+		// restored registers
+		for (int wire = 0; wire < n_wires; ++wire) {
+			if (find(frs_wires.begin(), frs_wires.end(), wire) != frs_wires.end()) continue;
+			if (((state[wire] ^ initial[wire]) & lanes) != 0) {
+				message = "qubit " + _wire_names[wire] + " is not restored";
+				return false;
+			}
+		}
+
+		// phases, in turns
+		vector<long double> expected(64, 0), tolerances(64, 0);
+		for (int g = 0; g < _gates.size(); ++g) {
+			unsigned long long f = (_gates[g].type == GATETYPE::CP) ? ~0ULL : 0;
+			for (int wire : gate_wires[g]) {
+				if (_gates[g].type == GATETYPE::CP)	f &= initial[wire];
+				else								f ^= initial[wire];
+			}
+			for (unsigned long long word = f & lanes; word != 0; word &= word - 1) {
+				expected[__builtin_ctzll(word)] += _turns[g];
+				tolerances[__builtin_ctzll(word)] += _tolerances[g];
+			}
+		}
+
+		for (int lane = 0; lane < n_lanes; ++lane) {
+			unsigned long long frs_before = 0, frs_after = 0;
+			for (int i = 0; i < _r; ++i) {
+				frs_before |= ((initial[frs_wires[i]] >> lane) & 1ULL) << (_r - 1 - i);
+				frs_after |= ((state[frs_wires[i]] >> lane) & 1ULL) << (_r - 1 - i);
+			}
+			unsigned long long added = (frs_after - frs_before) & _mask;	// the value added to "frs"
+			long double turns = _is_same ? added * _turns[0] : ldexpl(added, -_r);	// each increment of "frs" is a rotation by the same angle
+
+			long double residual = turns + phases[lane] - expected[lane];
+			if (first == 0 && lane == 0) {
+				global_phase = residual;
+				global_tolerance = tolerances[0];
+			}
+			residual -= global_phase;
+			residual -= floorl(residual + 0.5L);		// modulo a full turn, in [-1/2, 1/2)
+			if (fabsl(residual) > tolerances[lane] + global_tolerance) {
+				stringstream ss;
+				ss << "the phase of input";
+				for (int wire : data_wires) ss << " " << _wire_names[wire] << "=" << ((initial[wire] >> lane) & 1ULL);
+				ss << " is off by " << (double)(residual * 2 * M_PIl) << " rad (tolerance " << (double)((tolerances[lane] + global_tolerance) * 2 * M_PIl) << " rad)";
+				message = ss.str();
+				return false;
+			}
+		}
+	}
+	message = to_string(n_inputs) + (is_exhaustive ? " inputs (all)" : " random inputs");
+	return true;
+}
+
+/* ===== Function Description:
+	Count the gates of a lowered circuit, and add them to the counts of the previous calls.
+	Gates controlled by measurement results ("if(...)") are counted as the gates themselves,
+	and the T-depth is the largest number of T gates on a path through the qubits.
+*/
+void CliffordTCounter::count(const string& circuit) {
+	static const set<string> clifford_gates = { "id", "x", "y", "z", "h", "s", "sdg", "cx", "cy", "cz", "swap" };
+	static const set<string> rotation_gates = { "rx", "ry", "rz", "p", "u1" };
+
+	stringstream circuit_ss(circuit);
+	string line;
+	while (getline(circuit_ss, line)) {
+		string gate_name, condition, target;
+		vector<string> qubits;
+		if (!parseGateLine(line, gate_name, qubits, condition, target) || gate_name == "barrier") continue;
+
+		bool is_t = (gate_name == "t" || gate_name == "tdg");
+		if (is_t)									t_count++;
+		else if (clifford_gates.count(gate_name))	n_clifford++;
+		else if (rotation_gates.count(gate_name))	n_rotation++;
+		else if (gate_name == "measure")			n_measure++;
+		else										other_gates.insert(gate_name);
+
+		int depth = 0;
+		for (string& qubit : qubits) depth = max(depth, _t_depths[qubit]);
+		if (is_t) depth++;
+		for (string& qubit : qubits) _t_depths[qubit] = depth;
+		t_depth = max(t_depth, depth);
+	}
+}
+
+/* ===== Function Description:
+	Parse a line of a circuit into its gate name and operands,
+	the classical register of its condition ("if(c==1) ..."), and the target of a measurement ("... -> c[0];"), which are empty if none.
+	Return false if the line has no gate, e.g., an empty line, a comment, or a declaration.
+*/
+bool parseGateLine(string line, string& gate_name, vector<string>& operands, string& condition, string& target) {
+	operands.clear();
+	condition.clear();
+	target.clear();
+	auto strip = [](string text) {
+		text.erase(remove_if(text.begin(), text.end(), ::isspace), text.end());
+		return text;
+	};
+
+	line = line.substr(0, line.find("//"));
+	size_t begin = line.find_first_not_of(" \t\r");
+	if (begin == string::npos) return false;
+	line = line.substr(begin);
+	if (line.compare(0, 3, "if(") == 0 || line.compare(0, 3, "if ") == 0) {
+		size_t open = line.find('(');
+		condition = strip(line.substr(open + 1, line.find("==") - open - 1));
+		line = line.substr(line.find(')') + 1);
+		line = line.substr(line.find_first_not_of(" \t"));
+	}
+
+	gate_name = line.substr(0, line.find_first_of(" (\t"));
+	if (gate_name == "OPENQASM" || gate_name == "include" || gate_name == "qreg" || gate_name == "creg" || gate_name == "gate" || gate_name == "opaque") return false;
+
+	size_t pos = (line.find('(') < line.find(' ')) ? line.find(')') + 1 : gate_name.size();
+	size_t arrow = line.find("->");
+	if (arrow != string::npos) target = strip(line.substr(arrow + 2, line.find(';') - arrow - 2));
+	stringstream operands_ss(line.substr(pos, min(line.find(';'), arrow) - pos));
+	string operand;
+	while (getline(operands_ss, operand, ',')) {
+		operand = strip(operand);
+		if (!operand.empty()) operands.emplace_back(operand);
+	}
+	return true;
+}
+
+/* ===== Function Description:
+	Get the Pauli type of a gate on its operand as 'getPauliType', including the rotation gates,
+	so that two gates acting on a qubit by the same type commute on it. Return 'n' if there is no such type.
+*/
+static char schedulingType(const string& gate_name, int operand_index) {
+	char type = getPauliType(gate_name, operand_index);
+	if (type != 'n') return type;
+	if (gate_name == "rz" || gate_name == "p" || gate_name == "rzz" || gate_name == "cp" || gate_name == "crz" || gate_name == "cu1") return 'z';
+	if (gate_name == "rx" || gate_name == "rxx") return 'x';
+	if (gate_name == "ry" || gate_name == "ryy") return 'y';
+	return 'n';
+}
+
+/* ===== Function Description:  // O(#gates * #operands)
+	Schedule the gates of a circuit into ASAP layers.
+	A gate follows the gates before it on each of its wires (qubits, and classical registers for measurements and conditions),
+	except that consecutive gates acting on a wire by the same Pauli type (see 'schedulingType') may pass each other,
+	e.g., CNOT gates with the same control or target, the diagonal gates on a qubit, or the gates conditioned on one register.
+	So the gates on a wire that do not commute keep their order, and the depth is the smallest one under these rules.
+	A barrier adds no layer, but the gates after it follow all gates before it on its wires.
+	Declarations and custom gate definitions are kept in the header, and the other comments are dropped.
+*/
+void Scheduler::schedule(const string& circuit) {
+	stringstream circuit_ss(circuit);
+	string line;
+	unordered_map<string, int> register_sizes;
+	unordered_map<string, Run> runs;		// wire -> the last run of commuting gates on it
+	bool in_definition = false;
+	while (getline(circuit_ss, line)) {
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		string gate_name, condition, target;
+		vector<string> operands;
+		if (in_definition || !parseGateLine(line, gate_name, operands, condition, target)) {
+			string keyword = line.substr(0, line.find_first_of(" \t["));
+			if (keyword == "qreg" || keyword == "creg") {
+				size_t open = line.find('[');
+				string name = line.substr(4, open - 4);
+				name.erase(remove_if(name.begin(), name.end(), ::isspace), name.end());
+				register_sizes[name] = stoi(line.substr(open + 1));
+				if (keyword == "qreg") _registers.emplace_back(name);
+			}
+			if (keyword == "gate") in_definition = true;
+			if (_layers.empty() || in_definition || keyword == "qreg" || keyword == "creg" || keyword == "opaque") _header.emplace_back(line);
+			if (in_definition && line.find('}') != string::npos) in_definition = false;
+			continue;
+		}
+
+		vector<pair<string, char>> wires;		// (wire, Pauli type of the gate on it)
+		for (int k = 0; k < operands.size(); ++k) {
+			char type = schedulingType(gate_name, k);
+			auto it = register_sizes.find(operands[k]);
+			if (it == register_sizes.end()) {
+				wires.emplace_back(operands[k], type);
+				continue;
+			}
+			for (int j = 0; j < it->second; ++j) wires.emplace_back(operands[k] + "[" + to_string(j) + "]", type);
+		}
+		if (!condition.empty()) wires.emplace_back(condition, 'z');		// conditions only read the register
+		if (!target.empty()) wires.emplace_back(target.substr(0, target.find('[')), 'n');
+
+		int layer = 0;
+		for (auto& wire : wires) {
+			const Run& run = runs[wire.first];
+			bool is_commuting = (wire.second != 'n' && wire.second == run.type);
+			layer = max(layer, is_commuting ? run.begin : run.end);
+		}
+		if (gate_name == "barrier") {
+			for (auto& wire : wires) runs[wire.first] = { 'n', layer, layer };
+			continue;
+		}
+
+		layer++;
+		for (auto& wire : wires) {
+			Run& run = runs[wire.first];
+			if (wire.second != 'n' && wire.second == run.type)	run.end = max(run.end, layer);
+			else												run = { wire.second, run.end, layer };
+		}
+		if (_layers.size() < layer) {
+			_layers.resize(layer);
+			widths.resize(layer, 0);
+			t_widths.resize(layer, 0);
+		}
+		_layers[layer - 1].emplace_back(line.substr(line.find_first_not_of(" \t")));
+		widths[layer - 1]++;
+		if (gate_name == "t" || gate_name == "tdg") t_widths[layer - 1]++;
+	}
+	depth = _layers.size();
+	n_t_layers = count_if(t_widths.begin(), t_widths.end(), [](int n) { return n > 0; });
+}
+
+/* ===== Function Description:
+	Get the scheduled circuit: the header, and the layers in order separated by barriers on all quantum registers,
+	where the gates of a layer keep their order in the input.
+*/
+string Scheduler::layeredCircuit() {
+	string barrier = "barrier";
+	for (int k = 0; k < _registers.size(); ++k) barrier += (k == 0 ? " " : ", ") + _registers[k];
+	barrier += ";";
+
+	stringstream ss;
+	for (const string& line : _header) ss << line << "\n";
+	for (int layer = 0; layer < _layers.size(); ++layer) {
+		if (layer > 0) ss << barrier << "\n";
+		for (const string& line : _layers[layer]) ss << line << "\n";
+	}
+	return ss.str();
+}
+
+/* ===== Function Description:
+	Schedule the openQASM circuit 'file_name' by 'scheduler', write the widths of the layers into 'csv_file_name' (if not empty),
+	and rewrite the circuit layer by layer (see 'Scheduler::layeredCircuit') if 'is_layered' is true.
+	Return false with a message if a file cannot be read or written.
+*/
+bool scheduleCircuit(const string& file_name, const string& csv_file_name, bool is_layered, Scheduler& scheduler, string& message) {
+	ifstream ifs(file_name);
+	if (!ifs) {
+		message = "cannot open \"" + file_name + "\"";
+		return false;
+	}
+	stringstream circuit_ss;
+	circuit_ss << ifs.rdbuf();
+	ifs.close();
+	scheduler.schedule(circuit_ss.str());
+
+	if (!csv_file_name.empty()) {
+		ofstream csv_ofs(csv_file_name);
+		if (!csv_ofs) {
+			message = "cannot write \"" + csv_file_name + "\"";
+			return false;
+		}
+		csv_ofs << "layer,width,t_gates\n";
+		for (int layer = 0; layer < scheduler.depth; ++layer) {
+			csv_ofs << layer << "," << scheduler.widths[layer] << "," << scheduler.t_widths[layer] << "\n";
+		}
+	}
+	if (is_layered) {
+		ofstream ofs(file_name);
+		if (!ofs) {
+			message = "cannot write \"" + file_name + "\"";
+			return false;
+		}
+		ofs << scheduler.layeredCircuit();
+	}
+	return true;
+}